@@ -534,6 +534,11 @@ int     lastepisode = -1;
 
 void AM_Start(void)
 {
+    // the automap's tables are built when it is first opened rather than
+    // at startup
+    if (!priorities)
+        AM_Init();
+
     if (!stopped)
         AM_Stop();
     stopped = false;
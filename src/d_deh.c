@@ -48,17 +48,22 @@
 #include "p_local.h"
 #include "g_game.h"
 #include "d_think.h"
+#include "i_timer.h"
 #include "version.h"
 #include "w_wad.h"
 #include "z_zone.h"
 
 // killough 10/98: new functions, to allow processing DEH files in-memory
 // (e.g. from wads)
+//
+// DEH files are now read into memory in one go as well, so both are
+// parsed straight out of a buffer rather than a line at a time from disk.
 
 typedef struct
 {
-    byte        *inp, *lump;    // Pointer to string or FILE
+    byte        *inp, *lump;    // Pointer to string
     long        size;
+    boolean     fromwad;        // lump is a cached wad lump rather than a malloced file
 } DEHFILE;
 
 boolean addtocount;
@@ -70,8 +75,6 @@ boolean dehacked = false;
 // haleyjd: got rid of macros for MSVC
 char *dehfgets(char *buf, size_t n, DEHFILE *fp)
 {
-    if (!fp->lump)                              // If this is a real file,
-        return fgets(buf, n, (FILE *)fp->inp);  // return regular fgets
     if (!n || !*fp->inp || fp->size <= 0)       // If no more characters
         return NULL;
     if (n == 1)
@@ -88,12 +91,47 @@ char *dehfgets(char *buf, size_t n, DEHFILE *fp)
 
 int dehfeof(DEHFILE *fp)
 {
-    return (!fp->lump ? feof((FILE *)fp->inp) : !*fp->inp || fp->size <= 0);
+    return (!*fp->inp || fp->size <= 0);
 }
 
 int dehfgetc(DEHFILE *fp)
 {
-    return (!fp->lump ? fgetc((FILE *)fp->inp) : (fp->size > 0 ? fp->size--, *fp->inp++ : EOF));
+    return (fp->size > 0 ? fp->size--, *fp->inp++ : EOF);
+}
+
+//
+// dehfopen
+// Read a whole DEH file into memory, turning CR/LF pairs into LFs as
+// reading it in text mode would have, so Text blocks still count the
+// same number of characters.
+//
+boolean dehfopen(char *filename, DEHFILE *fp)
+{
+    FILE        *file = fopen(filename, "rb");
+    long        size;
+    byte        *buffer;
+    long        i, j;
+
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    buffer = malloc(size + 1);
+    size = (long)fread(buffer, 1, size, file);
+    fclose(file);
+
+    for (i = j = 0; i < size; i++)
+        if (buffer[i] != '\r' || i + 1 >= size || buffer[i + 1] != '\n')
+            buffer[j++] = buffer[i];
+    buffer[j] = '\0';
+
+    fp->inp = fp->lump = buffer;
+    fp->size = j;
+    fp->fromwad = false;
+    return true;
 }
 
 // variables used in other routines
@@ -190,6 +228,7 @@ char *s_PD_YELLOWK = PD_YELLOWK;
 char *s_PD_YELLOWK2 = PD_YELLOWK2;
 
 char *s_GGSAVED = GGSAVED;
+char *s_GGNOTSAVED = GGNOTSAVED;
 char *s_GGLOADED = GGLOADED;
 char *s_GSCREENSHOT = GSCREENSHOT;
 
@@ -576,6 +615,7 @@ deh_strs deh_strlookup[] =
     { &s_PD_YELLOWK2,          "PD_YELLOWK2",          false },
 
     { &s_GGSAVED,              "GGSAVED",              false },
+    { &s_GGNOTSAVED,           "GGNOTSAVED",           false },
     { &s_GGLOADED,             "GGLOADED",             false },
     { &s_GSCREENSHOT,          "GSCREENSHOT",          false },
 
@@ -1525,6 +1565,125 @@ static const deh_bexptr deh_bexptrs[] =
 // to hold startup code pointers from INFO.C
 actionf_t deh_codeptr[NUMSTATES];
 
+// Hash tables for the keys, mnemonics and strings looked up on every line,
+// chained through a pool of nodes so an entry can sit in more than one chain.
+#define DEH_HASHSIZE    256
+
+typedef struct
+{
+    int         index;
+    int         next;
+} deh_hashnode_t;
+
+typedef struct
+{
+    int             first[DEH_HASHSIZE];
+    deh_hashnode_t  *nodes;
+    int             numnodes;
+    int             maxnodes;
+} deh_hash_t;
+
+static deh_hash_t       deh_mobjinfohash;
+static deh_hash_t       deh_mobjflagshash;
+static deh_hash_t       deh_bexptrshash;
+static deh_hash_t       deh_strkeyhash;
+static deh_hash_t       deh_strvaluehash;
+
+static unsigned int deh_Hash(const char *s)
+{
+    unsigned int        result = 5381;
+
+    while (*s)
+        result = ((result << 5) ^ result) ^ toupper(*s++);
+
+    return (result & (DEH_HASHSIZE - 1));
+}
+
+static void deh_AddToHash(deh_hash_t *hash, const char *key, int index)
+{
+    unsigned int        h = deh_Hash(key);
+
+    if (hash->numnodes == hash->maxnodes)
+    {
+        hash->maxnodes = (hash->maxnodes ? hash->maxnodes * 2 : 64);
+        hash->nodes = realloc(hash->nodes, hash->maxnodes * sizeof(deh_hashnode_t));
+    }
+    hash->nodes[hash->numnodes].index = index;
+    hash->nodes[hash->numnodes].next = hash->first[h];
+    hash->first[h] = hash->numnodes++;
+}
+
+//
+// deh_FindInHash
+// Returns the lowest index whose key, as returned by getkey, matches key
+// without regard to case, or -1 if there isn't one. This is the same entry
+// a linear strcasecmp scan of the table would have found.
+//
+static int deh_FindInHash(deh_hash_t *hash, const char *key, const char *(*getkey)(int))
+{
+    int         node = hash->first[deh_Hash(key)];
+    int         found = -1;
+
+    while (node >= 0)
+    {
+        int     index = hash->nodes[node].index;
+
+        if ((found < 0 || index < found) && !strcasecmp(getkey(index), key))
+            found = index;
+        node = hash->nodes[node].next;
+    }
+    return found;
+}
+
+static const char *deh_MobjInfoKey(int i)
+{
+    return deh_mobjinfo[i];
+}
+
+static const char *deh_MobjFlagsKey(int i)
+{
+    return deh_mobjflags[i].name;
+}
+
+static const char *deh_BexPtrsKey(int i)
+{
+    return deh_bexptrs[i].lookup;
+}
+
+static const char *deh_StrKey(int i)
+{
+    return deh_strlookup[i].lookup;
+}
+
+static const char *deh_StrValue(int i)
+{
+    return *deh_strlookup[i].ppstr;
+}
+
+static void deh_InitHash(deh_hash_t *hash, int count, const char *(*getkey)(int))
+{
+    int i;
+
+    memset(hash->first, -1, sizeof(hash->first));
+    for (i = 0; i < count; i++)
+        deh_AddToHash(hash, getkey(i), i);
+}
+
+static void deh_InitHashes(void)
+{
+    static boolean      initialized;
+
+    if (initialized)
+        return;
+    initialized = true;
+
+    deh_InitHash(&deh_mobjinfohash, DEH_MOBJINFOMAX, deh_MobjInfoKey);
+    deh_InitHash(&deh_mobjflagshash, DEH_MOBJFLAGMAX, deh_MobjFlagsKey);
+    deh_InitHash(&deh_bexptrshash, arrlen(deh_bexptrs), deh_BexPtrsKey);
+    deh_InitHash(&deh_strkeyhash, deh_numstrlookup, deh_StrKey);
+    deh_InitHash(&deh_strvaluehash, deh_numstrlookup, deh_StrValue);
+}
+
 boolean CheckPackageWADVersion(void)
 {
     DEHFILE             infile, *filein = &infile;
@@ -1536,6 +1695,7 @@ boolean CheckPackageWADVersion(void)
         {
             infile.size = W_LumpLength(i);
             infile.inp = infile.lump = W_CacheLumpNum(i, PU_STATIC);
+            infile.fromwad = true;
 
             while (dehfgets(inbuffer, sizeof(inbuffer), filein))
             {
@@ -1568,6 +1728,8 @@ void ProcessDehFile(char *filename, char *outfilename, int lumpnum)
     DEHFILE     infile, *filein = &infile;      // killough 10/98
     char        inbuffer[DEH_BUFFERMAX];        // Place to put the primary infostring
     const char  *file_or_lump;
+    uint64_t    start = I_GetTimeUS();
+    int         lines = 0;
 
 #ifdef _DEBUG
     // Open output file if we're writing output
@@ -1588,15 +1750,15 @@ void ProcessDehFile(char *filename, char *outfilename, int lumpnum)
     // killough 10/98: allow DEH files to come from wad lumps
     if (filename)
     {
-        if (!(infile.inp = (void *)fopen(filename, "rt")))
+        if (!dehfopen(filename, &infile))
             return;     // should be checked up front anyway
-        infile.lump = NULL;
         file_or_lump = "file";
     }
     else        // DEH file comes from lump indicated by third argument
     {
         infile.size = W_LumpLength(lumpnum);
         infile.inp = infile.lump = W_CacheLumpNum(lumpnum, PU_STATIC);
+        infile.fromwad = true;
         filename = lumpinfo[lumpnum].wad_file->path;
         file_or_lump = "lump from";
     }
@@ -1611,12 +1773,15 @@ void ProcessDehFile(char *filename, char *outfilename, int lumpnum)
             deh_codeptr[i] = states[i].action;
     }
 
+    deh_InitHashes();
+
     // loop until end of file
     while (dehfgets(inbuffer, sizeof(inbuffer), filein))
     {
         int     i;
 
         lfstrip(inbuffer);
+        lines++;
         if (fileout)
             fprintf(fileout, "Line='%s'\n", inbuffer);
         if (!*inbuffer || *inbuffer == '#' || *inbuffer == ' ')
@@ -1637,7 +1802,7 @@ void ProcessDehFile(char *filename, char *outfilename, int lumpnum)
 
             // killough 10/98: exclude if inside wads (only to discourage
             // the practice, since the code could otherwise handle it)
-            if (infile.lump)
+            if (infile.fromwad)
             {
                 if (fileout)
                     fprintf(fileout, "No files may be included from wads: %s\n", inbuffer);
@@ -1676,10 +1841,18 @@ void ProcessDehFile(char *filename, char *outfilename, int lumpnum)
             }
     }
 
-    if (infile.lump)
+    if (infile.fromwad)
         Z_ChangeTag(infile.lump, PU_CACHE);     // Mark purgable
-    else if (infile.inp)
-        fclose((FILE *)infile.inp);             // Close real file
+    else
+        free(infile.lump);                      // Free file buffer
+
+    if (devparm)
+    {
+        uint64_t        time = I_GetTimeUS() - start;
+
+        printf("ProcessDehFile: %s %s, %i lines in %i.%03ims\n", file_or_lump, filename, lines,
+            (int)(time / 1000), (int)(time % 1000));
+    }
 
     if (outfilename)                            // killough 10/98: only at top recursion level
     {
@@ -1706,8 +1879,7 @@ void deh_procBexCodePointers(DEHFILE *fpin, FILE* fpout, char *line)
     char        inbuffer[DEH_BUFFERMAX];
     int         indexnum;
     char        mnemonic[DEH_MAXKEYLEN];        // to hold the codepointer mnemonic
-    int         i;                              // looper
-    boolean     found;                          // know if we found this one during lookup or not
+    int         i;                              // index of the mnemonic in deh_bexptrs
 
     // Ty 05/16/98 - initialize it to something, dummy!
     strncpy(inbuffer, line, DEH_BUFFERMAX);
@@ -1742,24 +1914,15 @@ void deh_procBexCodePointers(DEHFILE *fpin, FILE* fpout, char *line)
         strcpy(key, "A_");      // reusing the key area to prefix the mnemonic
         strcat(key, ptr_lstrip(mnemonic));
 
-        found = false;
-        i = -1; // incremented to start at zero at the top of the loop
-        do      // Ty 05/16/98 - fix loop logic to look for null ending entry
-        {
-            ++i;
-            if (!strcasecmp(key, deh_bexptrs[i].lookup))
-            {   // Ty 06/01/98  - add  to states[].action for new djgcc version
-                states[indexnum].action = deh_bexptrs[i].cptr;  // assign
-                if (fpout)
-                    fprintf(fpout, " - applied %p from codeptr[%d] to states[%d]\n",
-                        (void *)deh_bexptrs[i].cptr.acp1, i, indexnum);
-                found = true;
-            }
-        } while (!found && (deh_bexptrs[i].lookup != NULL));
-
-        if (!found)
+        if ((i = deh_FindInHash(&deh_bexptrshash, key, deh_BexPtrsKey)) >= 0)
+        {   // Ty 06/01/98  - add  to states[].action for new djgcc version
+            states[indexnum].action = deh_bexptrs[i].cptr;      // assign
             if (fpout)
-                fprintf(fpout, "Invalid frame pointer mnemonic '%s' at %d\n", mnemonic, indexnum);
+                fprintf(fpout, " - applied %p from codeptr[%d] to states[%d]\n",
+                    (void *)deh_bexptrs[i].cptr.acp1, i, indexnum);
+        }
+        else if (fpout)
+            fprintf(fpout, "Invalid frame pointer mnemonic '%s' at %d\n", mnemonic, indexnum);
     }
     return;
 }
@@ -1825,45 +1988,41 @@ void deh_procThing(DEHFILE *fpin, FILE* fpout, char *line)
                 fprintf(fpout, "Bad data pair in '%s'\n", inbuffer);
             continue;
         }
-        for (ix = 0; ix < DEH_MOBJINFOMAX; ix++)
+        if ((ix = deh_FindInHash(&deh_mobjinfohash, key, deh_MobjInfoKey)) >= 0)  // killough 8/98
         {
-            if (!strcasecmp(key, deh_mobjinfo[ix]))     // killough 8/98
+            if (!strcasecmp(key, "bits") && !value)     // killough 10/98
             {
-                if (!strcasecmp(key, "bits") && !value) // killough 10/98
+                // figure out what the bits are
+                value = 0;
+
+                // killough 10/98: replace '+' kludge with strtok() loop
+                // Fix error-handling case ('found' var wasn't being reset)
+                //
+                // Use OR logic instead of addition, to allow repetition
+                for (; (strval = strtok(strval, ",+| \t\f\r")); strval = NULL)
                 {
-                    // figure out what the bits are
-                    value = 0;
-
-                    // killough 10/98: replace '+' kludge with strtok() loop
-                    // Fix error-handling case ('found' var wasn't being reset)
-                    //
-                    // Use OR logic instead of addition, to allow repetition
-                    for (; (strval = strtok(strval, ",+| \t\f\r")); strval = NULL)
+                    int iy = deh_FindInHash(&deh_mobjflagshash, strval, deh_MobjFlagsKey);
+
+                    if (iy >= 0)
                     {
-                        int iy;
-                        for (iy = 0; iy < DEH_MOBJFLAGMAX; iy++)
-                            if (!strcasecmp(strval, deh_mobjflags[iy].name))
-                            {
-                                if (fpout)
-                                    fprintf(fpout, "ORed value 0x%08lx %s\n",
-                                        deh_mobjflags[iy].value, strval);
-                                value |= deh_mobjflags[iy].value;
-                                break;
-                            }
-                        if (iy >= DEH_MOBJFLAGMAX && fpout)
-                            fprintf(fpout, "Could not find bit mnemonic %s\n", strval);
+                        if (fpout)
+                            fprintf(fpout, "ORed value 0x%08lx %s\n",
+                                deh_mobjflags[iy].value, strval);
+                        value |= deh_mobjflags[iy].value;
                     }
-
-                    // Don't worry about conversion -- simply print values
-                    if (fpout)
-                        fprintf(fpout, "Bits = 0x%08lX = %ld \n", value, value);
+                    else if (fpout)
+                        fprintf(fpout, "Could not find bit mnemonic %s\n", strval);
                 }
-                pix = (int *)&mobjinfo[indexnum];
-                pix[ix] = (int)value;
+
+                // Don't worry about conversion -- simply print values
                 if (fpout)
-                    fprintf(fpout, "Assigned %d to %s(%d) at index %d\n",
-                        (int)value, key, indexnum, ix);
+                    fprintf(fpout, "Bits = 0x%08lX = %ld \n", value, value);
             }
+            pix = (int *)&mobjinfo[indexnum];
+            pix[ix] = (int)value;
+            if (fpout)
+                fprintf(fpout, "Assigned %d to %s(%d) at index %d\n",
+                    (int)value, key, indexnum, ix);
         }
     }
     return;
@@ -2874,72 +3033,69 @@ void deh_procStrings(DEHFILE *fpin, FILE* fpout, char *line)
 //
 boolean deh_procStringSub(char *key, char *lookfor, char *newstring, FILE *fpout)
 {
-    boolean     found = false;  // loop exit flag
-    int         i;              // looper
+    boolean     found;          // string found flag
+    int         i;              // index of the string in deh_strlookup
+
+    i = (lookfor ? deh_FindInHash(&deh_strvaluehash, lookfor, deh_StrValue) :
+        deh_FindInHash(&deh_strkeyhash, key, deh_StrKey));
+    found = (i >= 0);
 
-    for (i = 0; i < deh_numstrlookup; i++)
+    if (found)
     {
-        found = (lookfor ? !strcasecmp(*deh_strlookup[i].ppstr, lookfor) :
-            !strcasecmp(deh_strlookup[i].lookup, key));
+        char    *t;
 
-        if (found)
+        if (deh_strlookup[i].assigned)
         {
-            char        *t;
+            if (fpout)
+                fprintf(fpout, "Key %s already assigned\n", key);
+            return found;
+        }
 
-            if (deh_strlookup[i].assigned)
-            {
-                if (fpout)
-                    fprintf(fpout, "Key %s already assigned\n", key);
-                break;
-            }
+        *deh_strlookup[i].ppstr = t = strdup(newstring);        // orphan originalstring
 
-            *deh_strlookup[i].ppstr = t = strdup(newstring);    // orphan originalstring
-            found = true;
+        // Handle embedded \n's in the incoming string, convert to 0x0a's
+        {
+            const char  *s;
 
-            // Handle embedded \n's in the incoming string, convert to 0x0a's
+            for (s = *deh_strlookup[i].ppstr; *s; ++s, ++t)
             {
-                const char      *s;
-
-                for (s = *deh_strlookup[i].ppstr; *s; ++s, ++t)
+                if (*s == '\\' && (s[1] == 'n' || s[1] == 'N'))         // found one
                 {
-                    if (*s == '\\' && (s[1] == 'n' || s[1] == 'N'))     // found one
-                    {
-                        ++s;
-                        *t = '\n';      // skip one extra for second character
-                    }
-                    else
-                        *t = *s;
+                    ++s;
+                    *t = '\n';  // skip one extra for second character
                 }
-                *t = '\0';              // cap off the target string
+                else
+                    *t = *s;
             }
+            *t = '\0';          // cap off the target string
+        }
 
-            if (key)
-                if (fpout)
-                    fprintf(fpout, "Assigned key %s => '%s'\n", key, newstring);
+        // the string can now be looked up by its new value as well
+        deh_AddToHash(&deh_strvaluehash, *deh_strlookup[i].ppstr, i);
 
-            if (!key)
-                if (fpout)
-                    fprintf(fpout, "Assigned '%.12s%s' to '%.12s%s' at key %s\n",
-                        lookfor, (strlen(lookfor) > 12 ? "..." : ""),
-                        newstring, (strlen(newstring) > 12 ? "..." : ""),
-                        deh_strlookup[i].lookup);
+        if (key)
+            if (fpout)
+                fprintf(fpout, "Assigned key %s => '%s'\n", key, newstring);
 
-            if (!key)   // must have passed an old style string so show BEX
-                if (fpout)
-                    fprintf(fpout, "*BEX FORMAT:\n%s=%s\n*END BEX\n",
-                        deh_strlookup[i].lookup, dehReformatStr(newstring));
+        if (!key)
+            if (fpout)
+                fprintf(fpout, "Assigned '%.12s%s' to '%.12s%s' at key %s\n",
+                    lookfor, (strlen(lookfor) > 12 ? "..." : ""),
+                    newstring, (strlen(newstring) > 12 ? "..." : ""),
+                    deh_strlookup[i].lookup);
 
-            deh_strlookup[i].assigned = true;
+        if (!key)       // must have passed an old style string so show BEX
+            if (fpout)
+                fprintf(fpout, "*BEX FORMAT:\n%s=%s\n*END BEX\n",
+                    deh_strlookup[i].lookup, dehReformatStr(newstring));
 
-            if (M_StrCaseStr(deh_strlookup[i].lookup, "HUSTR"))
-                addtocount = true;
+        deh_strlookup[i].assigned = true;
 
-            break;
-        }
+        if (M_StrCaseStr(deh_strlookup[i].lookup, "HUSTR"))
+            addtocount = true;
     }
-    if (!found)
-        if (fpout)
-            fprintf(fpout, "Could not find '%.12s'\n", key ? key : lookfor);
+    else if (fpout)
+        fprintf(fpout, "Could not find '%.12s'\n", key ? key : lookfor);
 
     return found;
 }
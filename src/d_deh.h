@@ -143,6 +143,7 @@ extern char     *s_PD_YELLOWK;
 extern char     *s_PD_YELLOWK2;
 
 extern char     *s_GGSAVED;
+extern char     *s_GGNOTSAVED;
 extern char     *s_GGLOADED;
 extern char     *s_GSCREENSHOT;
 
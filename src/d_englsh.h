@@ -146,6 +146,7 @@
 // g_game.c
 //
 #define GGSAVED                 "game saved."
+#define GGNOTSAVED              "game not saved."
 
 //
 //  hu_stuff.c
@@ -63,6 +63,7 @@
 #include "i_swap.h"
 #include "i_system.h"
 #include "i_timer.h"
+#include "i_tinttab.h"
 #include "i_video.h"
 #include "m_argv.h"
 #include "m_config.h"
@@ -355,6 +356,9 @@ void D_DoomLoop(void)
     {
         TryRunTics(); // will run at least one tic
 
+        // move any graphics read in the background into the zone
+        W_UpdatePrefetch();
+
         if (players[displayplayer].mo)
             S_UpdateSounds(players[displayplayer].mo);  // move positional sounds
 
@@ -994,6 +998,26 @@ static void D_ProcessDehInWad(void)
             ProcessDehFile(NULL, "-", i);
 }
 
+static uint64_t startuptime;
+static uint64_t startuptotal;
+
+//
+// D_StartupTime
+// With -devparm, print how long the part of startup that has just
+// finished took.
+//
+static void D_StartupTime(char *name)
+{
+    uint64_t    now = I_GetTimeUS();
+    uint64_t    time = now - startuptime;
+
+    startuptime = now;
+    startuptotal += time;
+
+    if (devparm)
+        printf("D_DoomMainSetup: %s %i.%03ims\n", name, (int)(time / 1000), (int)(time % 1000));
+}
+
 //
 // D_DoomMainSetup
 //
@@ -1004,6 +1028,8 @@ static void D_DoomMainSetup(void)
     int p;
     int choseniwad = 0;
 
+    startuptime = I_GetTimeUS();
+
     version = PACKAGE_VERSIONSTRING;
 
     iwadfile = D_FindIWAD();
@@ -1012,13 +1038,14 @@ static void D_DoomMainSetup(void)
 
     modifiedgame = false;
 
-    D_ProcessDehCommandLine();
-
     nomonsters = M_CheckParm("-nomonsters");
     respawnparm = M_CheckParm("-respawn");
     fastparm = M_CheckParm("-fast");
     devparm = M_CheckParm("-devparm");
 
+    D_ProcessDehCommandLine();
+    D_StartupTime("D_ProcessDehCommandLine");
+
     // turbo option
     p = M_CheckParm("-turbo");
     if (p)
@@ -1044,6 +1071,7 @@ static void D_DoomMainSetup(void)
 
     // Load configuration files before initialising other subsystems.
     M_LoadDefaults();
+    D_StartupTime("M_LoadDefaults");
 
     if (!M_FileExists(PACKAGE_WAD))
         I_Error("Can't find %s.", uppercase(PACKAGE_WAD));
@@ -1151,7 +1179,10 @@ static void D_DoomMainSetup(void)
         }
     }
 
+    D_StartupTime("W_MergeFile");
+
     I_InitGraphics();
+    D_StartupTime("I_InitGraphics");
 
     if (!iwadfile && !modifiedgame && !choseniwad)
         I_Error("Game mode indeterminate. No IWAD file was found. Try\n"
@@ -1210,6 +1241,7 @@ static void D_DoomMainSetup(void)
     D_ProcessDehInWad();
     D_SetGameDescription();
     D_SetSaveGameDir();
+    D_StartupTime("D_IdentifyVersion");
 
     // Check for -file in shareware
     if (modifiedgame)
@@ -1355,25 +1387,47 @@ static void D_DoomMainSetup(void)
                            (bloodsplats ? P_SpawnBloodSplat2 : P_NullBloodSplatSpawner)));
 
     M_Init();
+    D_StartupTime("M_Init");
 
     R_Init();
+    D_StartupTime("R_Init");
 
     P_Init();
+    D_StartupTime("P_Init");
 
     S_Init((int)(sfxVolume * 127.0f / 15.0f), (int)(musicVolume * 127.0f / 15.0f));
+    D_StartupTime("S_Init");
 
     D_CheckNetGame();
 
     HU_Init();
 
     ST_Init();
-
-    AM_Init();
+    D_StartupTime("ST_Init");
+
+    // the automap is initialized when it is first opened, and the
+    // intermission and finale graphics when they are first shown
+
+    I_FinishTintTables();
+    D_StartupTime("I_FinishTintTables");
+
+    //!
+    // @arg <tics>
+    //
+    // Load every map in the IWAD and PWADs one after the other without
+    // rendering, running the playsim for the given number of tics on each,
+    // write a line of JSON per map to stdout and then quit.
+    //
+    p = M_CheckParmWithArgs("-benchmark", 1);
+    if (p)
+        G_Benchmark(atoi(myargv[p + 1]));
+    else if (M_CheckParm("-benchmark"))
+        G_Benchmark(0);
 
     if (startloadgame >= 0)
     {
         I_InitKeyboard();
-        G_LoadGame(P_SaveGameFile(startloadgame));
+        G_LoadGame(startloadgame);
     }
 
     splshttl = W_CacheLumpName("SPLSHTTL", PU_CACHE);
@@ -1382,6 +1436,11 @@ static void D_DoomMainSetup(void)
     titlelump = W_CacheLumpName(TITLEPIC ? "TITLEPIC" : (DMENUPIC ? "DMENUPIC" : "INTERPIC"), PU_CACHE);
     creditlump = W_CacheLumpName("CREDIT", PU_CACHE);
     playpal = (byte *)W_CacheLumpName("PLAYPAL", PU_CACHE);
+    D_StartupTime("title");
+
+    if (devparm)
+        printf("D_DoomMainSetup: total %i.%03ims\n", (int)(startuptotal / 1000),
+            (int)(startuptotal % 1000));
 
     if (gameaction != ga_loadgame)
     {
@@ -601,9 +601,9 @@ void G_DoLoadLevel(void)
     M_ClearRandom();
 
     // initialize the msecnode_t freelist.                     phares 3/25/98
-    // any nodes in the freelist are gone by now, cleared
-    // by Z_FreeTags() when the previous level ended or player
-    // died.
+    // every node in the pool is returned to it at once, since
+    // the things and sectors of the previous level are about
+    // to be freed.
     P_FreeSecNodeList();
 
     P_SetupLevel((gamemode == commercial ? (gamemission == pack_nerve ? 2 : 1) : gameepisode), gamemap);
@@ -817,6 +817,7 @@ boolean G_Responder(event_t *ev)
 }
 
 char    savename[256];
+static int      loadgameslot = -1;
 
 static byte saveg_read8(FILE *file)
 {
@@ -855,6 +856,26 @@ boolean G_CheckSaveGame(void)
 
 void D_Display(void);
 
+static char     savedmessage[128];
+
+// Say whether the last savegame was written, once it has been
+static void G_CheckSaveGameWritten(boolean wait)
+{
+    savestatus_t        status = (wait ? P_WaitForSaveGame() : P_SaveGameStatus());
+
+    if (status == SAVE_WRITTEN)
+    {
+        players[consoleplayer].message = savedmessage;
+        message_dontfuckwithme = true;
+        S_StartSound(NULL, sfx_swtchx);
+    }
+    else if (status == SAVE_FAILED)
+    {
+        players[consoleplayer].message = s_GGNOTSAVED;
+        message_dontfuckwithme = true;
+    }
+}
+
 //
 // G_Ticker
 // Make ticcmd_ts for the players.
@@ -872,6 +893,8 @@ void G_Ticker(void)
 
     P_MapEnd();
 
+    G_CheckSaveGameWritten(false);
+
     // do things to change the game state
     while (gameaction != ga_nothing)
     {
@@ -882,6 +905,7 @@ void G_Ticker(void)
                 break;
             case ga_reloadgame:
                 M_StringCopy(savename, P_SaveGameFile(quickSaveSlot), sizeof(savename));
+                loadgameslot = quickSaveSlot;
                 if (G_CheckSaveGame())
                     G_DoLoadGame();
                 else
@@ -1516,9 +1540,10 @@ extern boolean  setsizeneeded;
 
 void R_ExecuteSetViewSize(void);
 
-void G_LoadGame(char *name)
+void G_LoadGame(int slot)
 {
-    M_StringCopy(savename, name, sizeof(savename));
+    M_StringCopy(savename, P_SaveGameFile(slot), sizeof(savename));
+    loadgameslot = slot;
     gameaction = ga_loadgame;
 }
 
@@ -1528,40 +1553,43 @@ void G_DoLoadGame(void)
 
     gameaction = ga_nothing;
 
-    save_stream = fopen(savename, "rb");
-
-    if (save_stream == NULL)
-        return;
-
-    savegame_error = false;
-
-    if (!P_ReadSaveGameHeader(savedescription))
+    // if the savegame was made on this level, restore it from memory instead
+    if (P_LoadSnapshot(loadgameslot, savedescription))
     {
-        fclose(save_stream);
-        return;
+        if (paused)
+        {
+            paused = false;
+            S_ResumeSound();
+        }
     }
+    else
+    {
+        if (!P_OpenSaveGame(savename))
+            return;
 
-    savedleveltime = leveltime;
+        if (!P_ReadSaveGameHeader(savedescription))
+            return;
 
-    // load a base level
-    G_InitNew(gameskill, gameepisode, gamemap);
+        savedleveltime = leveltime;
 
-    leveltime = savedleveltime;
+        // load a base level
+        G_InitNew(gameskill, gameepisode, gamemap);
 
-    // dearchive all the modifications
-    P_UnArchivePlayers();
-    P_UnArchiveWorld();
-    P_UnArchiveThinkers();
-    P_UnArchiveSpecials();
+        leveltime = savedleveltime;
 
-    P_RestoreTargets();
+        // dearchive all the modifications
+        P_UnArchivePlayers();
+        P_UnArchiveWorld();
+        P_UnArchiveThinkers();
+        P_UnArchiveSpecials();
 
-    P_MapEnd();
+        P_RestoreTargets();
 
-    if (!P_ReadSaveGameEOF())
-        I_Error("Bad savegame");
+        P_MapEnd();
 
-    fclose(save_stream);
+        if (!P_ReadSaveGameEOF())
+            I_Error("Bad savegame");
+    }
 
     if (setsizeneeded)
         R_ExecuteSetViewSize();
@@ -1602,21 +1630,18 @@ void G_DoSaveGame(void)
 {
     char        *savegame_file;
     char        *temp_savegame_file;
-    static char buffer[128];
+
+    // report on the last save before starting another
+    G_CheckSaveGameWritten(true);
 
     temp_savegame_file = P_TempSaveGameFile();
     savegame_file = P_SaveGameFile(savegameslot);
 
-    // Open the savegame file for writing.  We write to a temporary file
-    // and then rename it at the end if it was successfully written.
+    // The savegame is archived in memory, then written in the background
+    // to a temporary file that is renamed if it was successfully written.
     // This prevents an existing savegame from being overwritten by
-    // a corrupted one, or if a savegame buffer overrun occurs.
-    save_stream = fopen(temp_savegame_file, "wb");
-
-    if (save_stream == NULL)
-        return;
-
-    savegame_error = false;
+    // a corrupted one.
+    P_CreateSaveGame();
 
     P_WriteSaveGameHeader(savedescription);
 
@@ -1627,19 +1652,14 @@ void G_DoSaveGame(void)
 
     P_WriteSaveGameEOF();
 
-    // Finish up, close the savegame file.
-    fclose(save_stream);
+    // keep it in memory too, so it can be loaded again quickly
+    P_SaveSnapshot(savegameslot, savedescription);
 
-    // Now rename the temporary savegame file to the actual savegame
-    // file, overwriting the old savegame if there was one there.
-    remove(savegame_file);
-    rename(temp_savegame_file, savegame_file);
+    P_WriteSaveGameFile(temp_savegame_file, savegame_file);
 
     // [BH] use the save description in the message displayed
-    M_snprintf(buffer, sizeof(buffer), s_GGSAVED, savedescription);
-    players[consoleplayer].message = buffer;
-    message_dontfuckwithme = true;
-    S_StartSound(NULL, sfx_swtchx);
+    // (shown by G_CheckSaveGameWritten() once the savegame has been written)
+    M_snprintf(savedmessage, sizeof(savedmessage), s_GGSAVED, savedescription);
 
     gameaction = ga_nothing;
     M_StringCopy(savedescription, "", sizeof(savedescription));
@@ -1790,3 +1810,96 @@ void G_InitNew(skill_t skill, int episode, int map)
 
     G_DoLoadLevel();
 }
+
+//
+// G_BenchmarkMap
+// Load a single map, optionally run the playsim on it for a number of
+// tics, and write a line of JSON describing how long it all took.
+//
+static void G_BenchmarkMap(char *lumpname, int episode, int map, int tics)
+{
+    size_t      bytesread = lumpbytesread;
+    uint64_t    start;
+    uint64_t    loadtime;
+    uint64_t    tictime = 0;
+    int         things = 0;
+    thinker_t   *th;
+    int         i;
+
+    zonepeak = zoneinuse;
+
+    start = I_GetTimeUS();
+    G_InitNew(startskill, episode, map);
+    loadtime = I_GetTimeUS() - start;
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+            things++;
+
+    if (tics)
+    {
+        for (i = 0; i < MAXPLAYERS; i++)
+            memset(&players[i].cmd, 0, sizeof(ticcmd_t));
+
+        start = I_GetTimeUS();
+        for (i = 0; i < tics; i++)
+        {
+            P_Ticker();
+            W_UpdatePrefetch();
+        }
+        tictime = I_GetTimeUS() - start;
+    }
+
+    printf("{\"map\":\"%s\",\"time\":%llu,\"bytesread\":%lu,\"lines\":%i,\"sectors\":%i,"
+        "\"segs\":%i,\"things\":%i,\"peakzone\":%lu,\"tics\":%i,\"tictime\":%llu}\n",
+        lumpname, (unsigned long long)loadtime, (unsigned long)(lumpbytesread - bytesread),
+        numlines, numsectors, numsegs, things, (unsigned long)zonepeak, tics,
+        (unsigned long long)tictime);
+    fflush(stdout);
+}
+
+//
+// G_Benchmark
+// Load every map in the IWAD and PWADs back to back without rendering
+// anything, then quit. Enabled with -benchmark.
+//
+void G_Benchmark(int tics)
+{
+    char        lumpname[6];
+    int         episode;
+    int         map;
+
+    if (gamemode == commercial)
+    {
+        GameMission_t   mission = gamemission;
+        int             pass;
+
+        // a second pass through No Rest for the Living's maps if it's loaded
+        for (pass = 1; pass <= (nerve ? 2 : 1); pass++)
+        {
+            if (nerve)
+                gamemission = (pass == 1 ? doom2 : pack_nerve);
+
+            for (map = 1; map <= (gamemission == pack_nerve ? 9 : 99); map++)
+            {
+                M_snprintf(lumpname, sizeof(lumpname), "MAP%02i", map);
+                if (W_CheckNumForName(lumpname) >= 0)
+                    G_BenchmarkMap(lumpname, 1, map, tics);
+            }
+        }
+
+        gamemission = mission;
+    }
+    else
+    {
+        for (episode = 1; episode <= 4; episode++)
+            for (map = 1; map <= 9; map++)
+            {
+                M_snprintf(lumpname, sizeof(lumpname), "E%iM%i", episode, map);
+                if (W_CheckNumForName(lumpname) >= 0)
+                    G_BenchmarkMap(lumpname, episode, map, tics);
+            }
+    }
+
+    I_Quit(true);
+}
@@ -57,9 +57,13 @@ void G_DeferredInitNew(skill_t skill, int episode, int map);
 
 void G_DeferredLoadLevel(skill_t skill, int episode, int map); // [BH]
 
+// Called by the startup code when -benchmark is given.
+// Loads every map in turn and then quits.
+void G_Benchmark(int tics);
+
 // Can be called by the startup code or M_Responder,
 // calls P_SetupLevel or W_EnterWorld.
-void G_LoadGame(char *name);
+void G_LoadGame(int slot);
 
 void G_DoLoadGame(void);
 
@@ -63,6 +63,12 @@ char            *timidity_cfg_path = TIMIDITY_CFG_PATH_DEFAULT;
 
 static char     *temp_timidity_cfg = NULL;
 
+#ifndef SDL20
+// SDL_mixer 1.2 won't free the SDL_RWops a song is loaded from, so keep
+// the one for the registered song until it's unregistered.
+static SDL_RWops        *songrwops;
+#endif
+
 // If the temp_timidity_cfg config variable is set, generate a "wrapper"
 // config file for Timidity to point to the actual config file. This
 // is needed to inject a "dir" command so that the patches are read
@@ -129,6 +135,204 @@ static void RemoveTimidityConfig(void)
     }
 }
 
+// Determine whether memory block is a .mid file
+static boolean IsMid(byte *mem, int len)
+{
+    return (len > 4 && !memcmp(mem, "MThd", 4));
+}
+
+// FNV-1a hash of a music lump, used to find it again in convertedsongs
+static uint64_t HashSong(byte *data, int len)
+{
+    uint64_t    hash = 0xCBF29CE484222325ull;
+    int         i;
+
+    for (i = 0; i < len; i++)
+        hash = (hash ^ data[i]) * 0x100000001B3ull;
+
+    return hash;
+}
+
+static MEMFILE *ConvertMus(byte *musdata, int len)
+{
+    MEMFILE     *instream = mem_fopen_read(musdata, len);
+    MEMFILE     *outstream = mem_fopen_write();
+
+    if (mus2mid(instream, outstream))
+    {
+        mem_fclose(outstream);
+        outstream = NULL;
+    }
+
+    mem_fclose(instream);
+
+    return outstream;
+}
+
+//
+// MUS lumps are converted to MIDI by a thread of their own, so that the
+// songs a level is going to need can be converted while it loads. The
+// results are kept, so a song that's played again is loaded straight
+// from memory. Only the conversion thread calls mus2mid(), since it
+// isn't reentrant.
+//
+typedef struct
+{
+    uint64_t    hash;
+    int         len;
+    byte        *mus;           // copy of the lump until it's converted
+    boolean     converted;
+    MEMFILE     *midi;          // NULL if the lump couldn't be converted
+} convertedsong_t;
+
+static convertedsong_t  *convertedsongs;
+static int              numconvertedsongs;
+
+static SDL_mutex        *songmutex;
+static SDL_cond         *songcond;
+static SDL_Thread       *songthread;
+static boolean          songthreadquit;
+
+static int SongThread(void *unused)
+{
+    SDL_LockMutex(songmutex);
+
+    while (!songthreadquit)
+    {
+        int     i;
+
+        for (i = 0; i < numconvertedsongs; i++)
+            if (convertedsongs[i].mus)
+                break;
+
+        if (i == numconvertedsongs)
+            SDL_CondWait(songcond, songmutex);
+        else
+        {
+            byte        *mus = convertedsongs[i].mus;
+            int         len = convertedsongs[i].len;
+            MEMFILE     *midi;
+
+            SDL_UnlockMutex(songmutex);
+            midi = ConvertMus(mus, len);
+            SDL_LockMutex(songmutex);
+
+            free(mus);
+            convertedsongs[i].mus = NULL;
+            convertedsongs[i].midi = midi;
+            convertedsongs[i].converted = true;
+            SDL_CondBroadcast(songcond);
+        }
+    }
+
+    SDL_UnlockMutex(songmutex);
+
+    return 0;
+}
+
+// Find a song in convertedsongs, adding it to the queue if it's not there.
+// Call with songmutex locked.
+static int QueueSong(byte *data, int len)
+{
+    uint64_t            hash = HashSong(data, len);
+    int                 i;
+    convertedsong_t     *song;
+
+    for (i = 0; i < numconvertedsongs; i++)
+        if (convertedsongs[i].hash == hash && convertedsongs[i].len == len)
+            return i;
+
+    convertedsongs = realloc(convertedsongs, (numconvertedsongs + 1) * sizeof(*convertedsongs));
+    song = &convertedsongs[numconvertedsongs];
+    song->hash = hash;
+    song->len = len;
+    song->mus = malloc(len);
+    memcpy(song->mus, data, len);
+    song->converted = false;
+    song->midi = NULL;
+
+    if (!songthread)
+    {
+        songthreadquit = false;
+#ifdef SDL20
+        songthread = SDL_CreateThread(SongThread, "mus2mid", NULL);
+#else
+        songthread = SDL_CreateThread(SongThread, NULL);
+#endif
+    }
+
+    SDL_CondBroadcast(songcond);
+
+    return numconvertedsongs++;
+}
+
+//
+// I_SDL_PrecacheSong
+// Have a song converted in the background, ready for when it's registered.
+//
+static void I_SDL_PrecacheSong(void *data, int len)
+{
+    if (!music_initialized || IsMid(data, len))
+        return;
+
+    SDL_LockMutex(songmutex);
+    QueueSong(data, len);
+    SDL_UnlockMutex(songmutex);
+}
+
+// Get the MIDI for a MUS lump, waiting for it to be converted if need be
+static MEMFILE *GetConvertedSong(byte *data, int len)
+{
+    int         i;
+    MEMFILE     *midi;
+
+    SDL_LockMutex(songmutex);
+    i = QueueSong(data, len);
+
+    if (songthread)
+        while (!convertedsongs[i].converted)
+            SDL_CondWait(songcond, songmutex);
+    else if (!convertedsongs[i].converted)
+    {
+        // couldn't start the thread, so convert it here
+        convertedsongs[i].midi = ConvertMus(convertedsongs[i].mus, len);
+        convertedsongs[i].converted = true;
+        free(convertedsongs[i].mus);
+        convertedsongs[i].mus = NULL;
+    }
+
+    midi = convertedsongs[i].midi;
+    SDL_UnlockMutex(songmutex);
+
+    return midi;
+}
+
+static void FreeConvertedSongs(void)
+{
+    int i;
+
+    if (songthread)
+    {
+        SDL_LockMutex(songmutex);
+        songthreadquit = true;
+        SDL_CondBroadcast(songcond);
+        SDL_UnlockMutex(songmutex);
+        SDL_WaitThread(songthread, NULL);
+        songthread = NULL;
+    }
+
+    for (i = 0; i < numconvertedsongs; i++)
+    {
+        free(convertedsongs[i].mus);
+        if (convertedsongs[i].midi)
+            mem_fclose(convertedsongs[i].midi);
+    }
+
+    free(convertedsongs);
+    convertedsongs = NULL;
+    numconvertedsongs = 0;
+}
+
 // Shutdown music
 static void I_SDL_ShutdownMusic(void)
 {
@@ -144,6 +348,16 @@ static void I_SDL_ShutdownMusic(void)
             sdl_was_initialized = false;
         }
     }
+
+    FreeConvertedSongs();
+
+    if (songmutex)
+    {
+        SDL_DestroyCond(songcond);
+        SDL_DestroyMutex(songmutex);
+        songcond = NULL;
+        songmutex = NULL;
+    }
 }
 
 static boolean SDLIsInitialized(void)
@@ -179,6 +393,9 @@ static boolean I_SDL_InitMusic(void)
         }
     }
 
+    songmutex = SDL_CreateMutex();
+    songcond = SDL_CreateCond();
+
     // Once initialization is complete, the temporary Timidity config
     // file can be removed.
     RemoveTimidityConfig();
@@ -247,59 +464,54 @@ static void I_SDL_UnRegisterSong(void *handle)
         return;
 
     Mix_FreeMusic(handle);
-}
-
-// Determine whether memory block is a .mid file
-static boolean IsMid(byte *mem, int len)
-{
-    return (len > 4 && !memcmp(mem, "MThd", 4));
-}
 
-static boolean ConvertMus(byte *musdata, int len, char *filename)
-{
-    MEMFILE     *instream = mem_fopen_read(musdata, len);
-    MEMFILE     *outstream = mem_fopen_write();
-    void        *outbuf;
-    size_t      outbuf_len;
-    int         result = mus2mid(instream, outstream);
-
-    if (!result)
+#ifndef SDL20
+    if (songrwops)
     {
-        mem_get_buf(outstream, &outbuf, &outbuf_len);
-        M_WriteFile(filename, outbuf, outbuf_len);
+        SDL_RWclose(songrwops);
+        songrwops = NULL;
     }
-
-    mem_fclose(instream);
-    mem_fclose(outstream);
-
-    return result;
+#endif
 }
 
 static void *I_SDL_RegisterSong(void *data, int len)
 {
-    char        *filename;
+    SDL_RWops   *rwops;
     Mix_Music   *music;
 
     if (!music_initialized)
         return NULL;
 
-    // MUS files begin with "MUS"
-    // Reject anything which doesn't have this signature
-    filename = M_TempFile("doom.mid");
-
     if (IsMid(data, len))
-        M_WriteFile(filename, data, len);
+        rwops = SDL_RWFromMem(data, len);
     else
+    {
         // Assume a MUS file and try to convert
-        ConvertMus(data, len, filename);
+        MEMFILE *midi = GetConvertedSong(data, len);
+        void    *buf;
+        size_t  buflen;
 
-    // Load the MIDI
-    music = Mix_LoadMUS(filename);
+        if (!midi)
+            return NULL;
 
-    // remove file now
-    remove(filename);
+        mem_get_buf(midi, &buf, &buflen);
+        rwops = SDL_RWFromMem(buf, buflen);
+    }
 
-    free(filename);
+    if (!rwops)
+        return NULL;
+
+    // Load the MIDI
+#ifdef SDL20
+    music = Mix_LoadMUS_RW(rwops, SDL_TRUE);
+#else
+    music = Mix_LoadMUS_RW(rwops);
+
+    if (music)
+        songrwops = rwops;
+    else
+        SDL_RWclose(rwops);
+#endif
 
     return music;
 }
@@ -332,6 +544,7 @@ music_module_t music_sdl_module =
     I_SDL_SetMusicVolume,
     I_SDL_PauseSong,
     I_SDL_ResumeSong,
+    I_SDL_PrecacheSong,
     I_SDL_RegisterSong,
     I_SDL_UnRegisterSong,
     I_SDL_PlaySong,
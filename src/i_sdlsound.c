@@ -40,6 +40,13 @@
 
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTMIX_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "doomstat.h"
+#include "m_argv.h"
 #include "m_config.h"
 #include "m_misc.h"
 #include "m_random.h"
@@ -57,38 +64,16 @@
 #define NUM_CHANNELS 32
 
 int snd_maxslicetime_ms = SND_MAXSLICETIME_MS_DEFAULT;
+boolean snd_softmixer = SND_SOFTMIXER_DEFAULT;
 
 static boolean sound_initialized = false;
 
 static Mix_Chunk sound_chunks[NUMSFX];
-static int channels_playing[NUM_CHANNELS];
 
 static int mixer_freq;
 static Uint16 mixer_format;
 static int mixer_channels;
 
-// When a sound stops, check if it is still playing. If it is not,
-// we can mark the sound data as CACHE to be freed back for other
-// means.
-static void ReleaseSoundOnChannel(int channel)
-{
-    int         i;
-    int         id = channels_playing[channel];
-
-    if (!id)
-        return;
-
-    channels_playing[channel] = sfx_None;
-
-    for (i = 0; i < NUM_CHANNELS; ++i)
-        // Playing on this channel? if so, don't release.
-        if (channels_playing[i] == id)
-            return;
-
-    // Not used on any channel, and can be safely released
-    Z_ChangeTag(sound_chunks[id].abuf, PU_CACHE);
-}
-
 static boolean ConvertibleRatio(int freq1, int freq2)
 {
     int         ratio;
@@ -110,20 +95,20 @@ static boolean ConvertibleRatio(int freq1, int freq2)
     }
 }
 
+// Calculate the length of the expanded version of a sample.
+static uint32_t ExpandedLength(int samplerate, uint32_t length)
+{
+    // Double up twice: 8 -> 16 bit and mono -> stereo
+    return (uint32_t)(((uint64_t)length * mixer_freq) / samplerate) * 4;
+}
+
 // Generic sound expansion function for any sample rate.
+// destination->abuf must already point to ExpandedLength() bytes.
+// This doesn't touch the zone, so can be called by any thread.
 static void ExpandSoundData_SDL(byte *data, int samplerate,
                                 uint32_t length, Mix_Chunk *destination)
 {
     SDL_AudioCVT        convertor;
-    uint32_t            expanded_length;
-
-    // Calculate the length of the expanded version of the sample.
-    expanded_length = (uint32_t)(((uint64_t)length * mixer_freq) / samplerate);
-
-    // Double up twice: 8 -> 16 bit and mono -> stereo
-    expanded_length *= 4;
-    destination->alen = expanded_length;
-    destination->abuf = Z_Malloc(expanded_length, PU_STATIC, (void **)&destination->abuf);
 
     // If we can, use the standard / optimized SDL conversion routines.
     if (samplerate <= mixer_freq
@@ -263,9 +248,10 @@ static boolean CacheSFX_SDL(int sound)
         return false;
 
     // Sample rate conversion
-    // sound_chunks[sound].alen and abuf are determined by ExpandSoundData.
     sound_chunks[sound].allocated = 1;
     sound_chunks[sound].volume = MIX_MAX_VOLUME;
+    sound_chunks[sound].alen = ExpandedLength(samplerate, length);
+    sound_chunks[sound].abuf = Z_Malloc(sound_chunks[sound].alen, PU_STATIC, NULL);
 
     ExpandSoundData_SDL(data, samplerate, length, &sound_chunks[sound]);
 
@@ -275,22 +261,345 @@ static boolean CacheSFX_SDL(int sound)
     return true;
 }
 
-static Mix_Chunk *GetSFXChunk(int sound_id)
+// A sound effect waiting to be converted by I_SDL_CacheSounds()
+typedef struct
 {
-    if (sound_chunks[sound_id].abuf == NULL)
+    int         sound;
+    int         lumpnum;
+    int         samplerate;
+    uint32_t    length;
+    byte        *data;
+} sfxjob_t;
+
+static sfxjob_t *sfxjobs;
+static int      numsfxjobs;
+static int      numsfxthreads;
+
+// Convert every numsfxthreads-th sound effect, starting with the one given.
+static int CacheSFXThread(void *first)
+{
+    int         i;
+
+    for (i = (int)(intptr_t)first; i < numsfxjobs; i += numsfxthreads)
+        ExpandSoundData_SDL(sfxjobs[i].data, sfxjobs[i].samplerate, sfxjobs[i].length,
+            &sound_chunks[sfxjobs[i].sound]);
+
+    return 0;
+}
+
+//
+// I_SDL_CacheSounds
+// Convert all the sound effects up front, so that none are converted in
+// the middle of the game. They are converted into one block by as many
+// threads as there are CPUs.
+//
+static void I_SDL_CacheSounds(sfxinfo_t *sounds, int num_sounds)
+{
+    int         i;
+    uint32_t    total = 0;
+    byte        *buffer;
+    SDL_Thread  **threads;
+
+    if (!sound_initialized)
+        return;
+
+    sfxjobs = malloc(num_sounds * sizeof(*sfxjobs));
+    numsfxjobs = 0;
+
+    // sounds[0] is a dummy
+    for (i = 1; i < num_sounds; i++)
     {
-        if (!CacheSFX_SDL(sound_id))
-            return NULL;
+        sfxjob_t        *job = &sfxjobs[numsfxjobs];
+
+        if (sounds[i].lumpnum < 0 || sound_chunks[i].abuf)
+            continue;
+
+        if (!LoadSoundLump(i, &job->lumpnum, &job->samplerate, &job->length, &job->data))
+            continue;
+
+        job->sound = i;
+        sound_chunks[i].allocated = 1;
+        sound_chunks[i].volume = MIX_MAX_VOLUME;
+        sound_chunks[i].alen = ExpandedLength(job->samplerate, job->length);
+        total += sound_chunks[i].alen;
+        numsfxjobs++;
     }
-    else
+
+    if (numsfxjobs)
     {
-        // don't free the sound while it is playing!
-        Z_ChangeTag(sound_chunks[sound_id].abuf, PU_STATIC);
+        buffer = Z_Malloc(total, PU_STATIC, NULL);
+
+        for (i = 0; i < numsfxjobs; i++)
+        {
+            sound_chunks[sfxjobs[i].sound].abuf = buffer;
+            buffer += sound_chunks[sfxjobs[i].sound].alen;
+        }
+
+#ifdef SDL20
+        numsfxthreads = MAX(1, MIN(SDL_GetCPUCount(), numsfxjobs));
+#else
+        numsfxthreads = 1;
+#endif
+        threads = malloc(numsfxthreads * sizeof(*threads));
+
+        // this thread converts its share too
+        for (i = 1; i < numsfxthreads; i++)
+#ifdef SDL20
+            threads[i] = SDL_CreateThread(CacheSFXThread, "sfx", (void *)(intptr_t)i);
+#else
+            threads[i] = SDL_CreateThread(CacheSFXThread, (void *)(intptr_t)i);
+#endif
+
+        CacheSFXThread((void *)0);
+
+        for (i = 1; i < numsfxthreads; i++)
+            if (threads[i])
+                SDL_WaitThread(threads[i], NULL);
+            else
+                CacheSFXThread((void *)(intptr_t)i);
+
+        free(threads);
+
+        for (i = 0; i < numsfxjobs; i++)
+            W_ReleaseLumpNum(sfxjobs[i].lumpnum);
     }
 
+    free(sfxjobs);
+    sfxjobs = NULL;
+}
+
+static Mix_Chunk *GetSFXChunk(int sound_id)
+{
+    // sounds missed by I_SDL_CacheSounds() are converted when first played
+    if (sound_chunks[sound_id].abuf == NULL && !CacheSFX_SDL(sound_id))
+        return NULL;
+
     return &sound_chunks[sound_id];
 }
 
+//
+// Software mixer
+// If snd_softmixer is set, sound effects aren't played on SDL_mixer's
+// channels, but mixed here into its output after the music, all in one
+// pass. Each channel's volume and separation are applied as left and right
+// gains that are ramped over each block, so they can be changed every
+// frame without clicks or calls into SDL.
+//
+#define SOFTMIX_CHANNELS        128
+#define SOFTMIX_BLOCK           256     // frames mixed at a time
+#define SOFTMIX_GAINBITS        15
+
+typedef struct
+{
+    Sint16      *data;                  // NULL if nothing is playing
+    int         length;                 // in frames
+    int         position;
+    int         left, right;            // gains wanted
+    int         curleft, curright;      // gains at the end of the last block
+} mixchannel_t;
+
+static boolean          softmixer;
+static mixchannel_t     mixchannels[SOFTMIX_CHANNELS];
+
+// Ramp from the last block's gain to the one wanted over a block of frames.
+#define RAMP(gain, delta, i, frames)    ((gain) + (delta) * (i) / (frames))
+
+// Add n frames of channel to mix, ramping the gains from the last block's
+// over the whole block, the same way with or without SSE2.
+static void MixChannel(mixchannel_t *channel, Sint32 *mix, int n, int frames)
+{
+    Sint16      *src = channel->data + channel->position * 2;
+    int         left = channel->curleft;
+    int         right = channel->curright;
+    int         dleft = channel->left - left;
+    int         dright = channel->right - right;
+    int         i = 0;
+
+#ifdef SOFTMIX_SSE2
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i gain = _mm_set_epi16(
+            RAMP(right, dright, i + 3, frames), RAMP(left, dleft, i + 3, frames),
+            RAMP(right, dright, i + 2, frames), RAMP(left, dleft, i + 2, frames),
+            RAMP(right, dright, i + 1, frames), RAMP(left, dleft, i + 1, frames),
+            RAMP(right, dright, i, frames), RAMP(left, dleft, i, frames));
+        __m128i samples = _mm_loadu_si128((__m128i *)(src + i * 2));
+        __m128i lo = _mm_mullo_epi16(samples, gain);
+        __m128i hi = _mm_mulhi_epi16(samples, gain);
+        __m128i *dest = (__m128i *)(mix + i * 2);
+
+        _mm_storeu_si128(dest, _mm_add_epi32(_mm_loadu_si128(dest),
+            _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), SOFTMIX_GAINBITS)));
+        _mm_storeu_si128(dest + 1, _mm_add_epi32(_mm_loadu_si128(dest + 1),
+            _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), SOFTMIX_GAINBITS)));
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        mix[i * 2] += (src[i * 2] * RAMP(left, dleft, i, frames)) >> SOFTMIX_GAINBITS;
+        mix[i * 2 + 1] += (src[i * 2 + 1] * RAMP(right, dright, i, frames)) >> SOFTMIX_GAINBITS;
+    }
+
+    channel->curleft = channel->left;
+    channel->curright = channel->right;
+}
+
+// Mix a block of frames of every playing channel into stream.
+static void MixBlock(Sint16 *stream, int frames)
+{
+    static Sint32       mix[SOFTMIX_BLOCK * 2];
+    int                 samples = frames * 2;
+    int                 i;
+
+    for (i = 0; i < samples; i++)
+        mix[i] = stream[i];
+
+    for (i = 0; i < SOFTMIX_CHANNELS; i++)
+    {
+        mixchannel_t    *channel = &mixchannels[i];
+        int             n;
+
+        if (!channel->data)
+            continue;
+
+        n = MIN(frames, channel->length - channel->position);
+        MixChannel(channel, mix, n, frames);
+
+        if ((channel->position += n) >= channel->length)
+            channel->data = NULL;
+    }
+
+    i = 0;
+
+#ifdef SOFTMIX_SSE2
+    for (; i + 8 <= samples; i += 8)
+        _mm_storeu_si128((__m128i *)(stream + i), _mm_packs_epi32(
+            _mm_loadu_si128((__m128i *)(mix + i)), _mm_loadu_si128((__m128i *)(mix + i + 4))));
+#endif
+
+    for (; i < samples; i++)
+        stream[i] = BETWEEN(-32768, mix[i], 32767);
+}
+
+// SDL_mixer post-mix callback, called by the audio thread
+static void MixSoundChannels(void *udata, Uint8 *stream, int len)
+{
+    Sint16      *samples = (Sint16 *)stream;
+    int         frames = len / 4;
+
+    while (frames > 0)
+    {
+        int     n = MIN(frames, SOFTMIX_BLOCK);
+
+        MixBlock(samples, n);
+        samples += n * 2;
+        frames -= n;
+    }
+}
+
+//
+// Offline rendering
+// With -wavout <file>, no audio device is opened. Sound effects are mixed
+// by the software mixer into a WAV file instead, as the game tics go by
+// rather than in real time, so what's written only depends on what the
+// game does. The mixer gives the same samples with or without SSE2, but
+// sound effects are converted by SDL and filtered in floating point first,
+// so files are only identical between builds that do that the same way.
+//
+static FILE     *wavfile;
+static int      wavstarttic;
+static uint32_t wavframes;
+
+static void WriteWavHeader(void)
+{
+    byte        header[44];
+    uint32_t    datalen = wavframes * 4;
+
+    memcpy(header, "RIFF", 4);
+    header[4] = (datalen + 36) & 0xFF;
+    header[5] = ((datalen + 36) >> 8) & 0xFF;
+    header[6] = ((datalen + 36) >> 16) & 0xFF;
+    header[7] = ((datalen + 36) >> 24) & 0xFF;
+    memcpy(header + 8, "WAVEfmt ", 8);
+    header[16] = 16;                    // fmt chunk length
+    header[17] = header[18] = header[19] = 0;
+    header[20] = 1;                     // PCM
+    header[21] = 0;
+    header[22] = 2;                     // stereo
+    header[23] = 0;
+    header[24] = mixer_freq & 0xFF;
+    header[25] = (mixer_freq >> 8) & 0xFF;
+    header[26] = (mixer_freq >> 16) & 0xFF;
+    header[27] = (mixer_freq >> 24) & 0xFF;
+    header[28] = (mixer_freq * 4) & 0xFF;
+    header[29] = ((mixer_freq * 4) >> 8) & 0xFF;
+    header[30] = ((mixer_freq * 4) >> 16) & 0xFF;
+    header[31] = ((mixer_freq * 4) >> 24) & 0xFF;
+    header[32] = 4;                     // bytes per frame
+    header[33] = 0;
+    header[34] = 16;                    // bits per sample
+    header[35] = 0;
+    memcpy(header + 36, "data", 4);
+    header[40] = datalen & 0xFF;
+    header[41] = (datalen >> 8) & 0xFF;
+    header[42] = (datalen >> 16) & 0xFF;
+    header[43] = (datalen >> 24) & 0xFF;
+
+    fwrite(header, 1, sizeof(header), wavfile);
+}
+
+// Mix everything up to the current tic into the WAV file.
+static void RenderToWav(void)
+{
+    uint32_t    target = (uint32_t)((int64_t)(gametic - wavstarttic) * mixer_freq / TICRATE);
+    Sint16      buffer[SOFTMIX_BLOCK * 2];
+
+    while (wavframes < target)
+    {
+        int     n = MIN(SOFTMIX_BLOCK, target - wavframes);
+
+        memset(buffer, 0, n * 4);
+        MixBlock(buffer, n);
+
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+        {
+            int i;
+
+            for (i = 0; i < n * 2; i++)
+                buffer[i] = SDL_SwapLE16(buffer[i]);
+        }
+#endif
+
+        fwrite(buffer, 4, n, wavfile);
+        wavframes += n;
+    }
+}
+
+static boolean OpenWavFile(char *filename)
+{
+    if (!(wavfile = fopen(filename, "wb")))
+        return false;
+
+    mixer_freq = snd_samplerate;
+    mixer_format = AUDIO_S16SYS;
+    mixer_channels = 2;
+    wavstarttic = gametic;
+    wavframes = 0;
+    WriteWavHeader();
+
+    return true;
+}
+
+static void CloseWavFile(void)
+{
+    RenderToWav();
+    fseek(wavfile, 0, SEEK_SET);
+    WriteWavHeader();
+    fclose(wavfile);
+    wavfile = NULL;
+}
+
 //
 // Retrieve the raw data lump index
 //  for a given SFX name.
@@ -301,7 +610,7 @@ static int I_SDL_GetSfxLumpNum(sfxinfo_t *sfx)
 
     M_snprintf(namebuf, 9, "ds%s", sfx->name);
 
-    return W_GetNumForName(namebuf);
+    return W_CheckNumForName(namebuf);
 }
 
 static void I_SDL_UpdateSoundParams(int handle, int vol, int sep)
@@ -311,10 +620,20 @@ static void I_SDL_UpdateSoundParams(int handle, int vol, int sep)
     if (!sound_initialized)
         return;
 
+    if (wavfile)
+        RenderToWav();
+
     left = (254 - sep) * vol / 127;
     right = sep * vol / 127;
 
-    Mix_SetPanning(handle, left, right);
+    if (softmixer)
+    {
+        // picked up by the audio thread at the start of the next block
+        mixchannels[handle].left = left << (SOFTMIX_GAINBITS - 8);
+        mixchannels[handle].right = right << (SOFTMIX_GAINBITS - 8);
+    }
+    else
+        Mix_SetPanning(handle, left, right);
 }
 
 //
@@ -336,9 +655,8 @@ static int I_SDL_StartSound(int id, int channel, int vol, int sep)
     if (!sound_initialized)
         return -1;
 
-    // Release a sound effect if there is already one playing
-    // on this channel
-    ReleaseSoundOnChannel(channel);
+    if (wavfile)
+        RenderToWav();
 
     // Get the sound data
     chunk = GetSFXChunk(id);
@@ -347,9 +665,22 @@ static int I_SDL_StartSound(int id, int channel, int vol, int sep)
         return -1;
 
     // play sound
-    Mix_PlayChannel(channel, chunk, 0);
+    if (softmixer)
+    {
+        mixchannel_t    *mixchannel = &mixchannels[channel];
+
+        SDL_LockAudio();
+        mixchannel->data = (Sint16 *)chunk->abuf;
+        mixchannel->length = chunk->alen / 4;
+        mixchannel->position = 0;
+        mixchannel->left = mixchannel->curleft = ((254 - sep) * vol / 127) << (SOFTMIX_GAINBITS - 8);
+        mixchannel->right = mixchannel->curright = (sep * vol / 127) << (SOFTMIX_GAINBITS - 8);
+        SDL_UnlockAudio();
+
+        return channel;
+    }
 
-    channels_playing[channel] = id;
+    Mix_PlayChannel(channel, chunk, 0);
 
     // set separation, etc.
     I_SDL_UpdateSoundParams(channel, vol, sep);
@@ -362,11 +693,17 @@ static void I_SDL_StopSound(int handle)
     if (!sound_initialized)
         return;
 
-    Mix_HaltChannel(handle);
+    if (wavfile)
+        RenderToWav();
 
-    // Sound data is no longer needed; release the
-    // sound data being used for this channel
-    ReleaseSoundOnChannel(handle);
+    if (softmixer)
+    {
+        SDL_LockAudio();
+        mixchannels[handle].data = NULL;
+        SDL_UnlockAudio();
+    }
+    else
+        Mix_HaltChannel(handle);
 }
 
 static boolean I_SDL_SoundIsPlaying(int handle)
@@ -374,6 +711,12 @@ static boolean I_SDL_SoundIsPlaying(int handle)
     if (handle < 0)
         return false;
 
+    if (wavfile)
+        RenderToWav();
+
+    if (softmixer)
+        return (mixchannels[handle].data != NULL);
+
     return Mix_Playing(handle);
 }
 
@@ -382,10 +725,23 @@ static void I_SDL_ShutdownSound(void)
     if (!sound_initialized)
         return;
 
+    sound_initialized = false;
+
+    if (wavfile)
+    {
+        CloseWavFile();
+        softmixer = false;
+        return;
+    }
+
+    if (softmixer)
+    {
+        Mix_SetPostMix(NULL, NULL);
+        softmixer = false;
+    }
+
     Mix_CloseAudio();
     SDL_QuitSubSystem(SDL_INIT_AUDIO);
-
-    sound_initialized = false;
 }
 
 // Calculate slice size, based on snd_maxslicetime_ms.
@@ -412,8 +768,19 @@ static boolean I_SDL_InitSound(void)
     for (i = 0; i < NUMSFX; ++i)
         sound_chunks[i].abuf = NULL;
 
-    for (i = 0; i < NUM_CHANNELS; ++i)
-        channels_playing[i] = sfx_None;
+    // render to a WAV file instead of an audio device?
+    if ((i = M_CheckParmWithArgs("-wavout", 1)))
+    {
+        if (!OpenWavFile(myargv[i + 1]))
+            return false;
+
+        softmixer = true;
+        numChannels = SOFTMIX_CHANNELS;
+        memset(mixchannels, 0, sizeof(mixchannels));
+        sound_initialized = true;
+
+        return true;
+    }
 
     if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
         return false;
@@ -423,11 +790,18 @@ static boolean I_SDL_InitSound(void)
 
     Mix_QuerySpec(&mixer_freq, &mixer_format, &mixer_channels);
 
-    // precache sounds to avoid slowdown inside game
-    for (i = 0; i < NUMSFX; i++)
-        CacheSFX_SDL(i);
-
-    Mix_AllocateChannels(NUM_CHANNELS);
+    // the software mixer needs 16-bit stereo, as sounds are expanded to
+    // the mixer's format
+    if (snd_softmixer && mixer_format == AUDIO_S16SYS && mixer_channels == 2)
+    {
+        softmixer = true;
+        numChannels = SOFTMIX_CHANNELS;
+        memset(mixchannels, 0, sizeof(mixchannels));
+        Mix_AllocateChannels(0);
+        Mix_SetPostMix(MixSoundChannels, NULL);
+    }
+    else
+        Mix_AllocateChannels(NUM_CHANNELS);
 
     SDL_PauseAudio(0);
 
@@ -448,6 +822,7 @@ sound_module_t sound_sdl_module =
     I_SDL_InitSound,
     I_SDL_ShutdownSound,
     I_SDL_GetSfxLumpNum,
+    I_SDL_CacheSounds,
     I_SDL_UpdateSoundParams,
     I_SDL_StartSound,
     I_SDL_StopSound,
@@ -62,6 +62,7 @@ void I_ShutdownWindows32(void);
 #include "m_argv.h"
 #include "m_config.h"
 #include "m_misc.h"
+#include "p_saveg.h"
 #include "s_sound.h"
 #include "SDL.h"
 #include "version.h"
@@ -78,6 +79,9 @@ void I_ShutdownWindows32(void);
 //
 void I_Quit (boolean shutdown)
 {
+    // don't lose a savegame that's still being written
+    P_WaitForSaveGame();
+
     if (shutdown)
     {
         S_Shutdown();
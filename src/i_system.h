@@ -54,9 +54,7 @@ void I_StartTic(void);
 
 // Called by M_Responder when quit is selected.
 // Clean exit, displays sell blurb.
-#ifdef WIN32
 void I_Quit (boolean shutdown);
-#endif
 
 void I_Error(char *error, ...);
 
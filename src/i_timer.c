@@ -70,6 +70,25 @@ int I_GetTimeMS(void)
     return (ticks - basetime);
 }
 
+//
+// Same as I_GetTime, but returns time in microseconds, as precisely as
+// the platform allows
+//
+uint64_t I_GetTimeUS(void)
+{
+#ifdef SDL20
+    static Uint64       frequency;
+    Uint64              counter = SDL_GetPerformanceCounter();
+
+    if (!frequency)
+        frequency = SDL_GetPerformanceFrequency();
+
+    return (counter / frequency * 1000000 + counter % frequency * 1000000 / frequency);
+#else
+    return ((uint64_t)SDL_GetTicks() * 1000);
+#endif
+}
+
 //
 // Sleep for a specified number of ms
 //
@@ -39,6 +39,8 @@
 #ifndef __I_TIMER__
 #define __I_TIMER__
 
+#include "doomtype.h"
+
 // Called by D_DoomLoop,
 // returns current time in tics.
 int I_GetTime(void);
@@ -46,6 +48,9 @@ int I_GetTime(void);
 // returns current time in ms
 int I_GetTimeMS(void);
 
+// returns current time in microseconds, for timing things
+uint64_t I_GetTimeUS(void);
+
 // Pause for a specified number of ms
 void I_Sleep(int ms);
 
@@ -39,6 +39,7 @@
 #include <math.h>
 
 #include "m_fixed.h"
+#include "SDL.h"
 #include "z_zone.h"
 
 #define ADDITIVE       -1
@@ -112,9 +113,8 @@ int FindNearestColor(byte *palette, int red, int green, int blue)
     return best_color;
 }
 
-static byte *GenerateTintTable(byte *palette, int percent, int colors)
+static void GenerateTintTable(byte *result, byte *palette, int percent, int colors)
 {
-    byte        *result = (byte *)Z_Malloc(65536, PU_STATIC, NULL);
     int         foreground, background;
 
     for (foreground = 0; foreground < 256; ++foreground)
@@ -164,29 +164,92 @@ static byte *GenerateTintTable(byte *palette, int percent, int colors)
         *(result + (77 << 8) + 109) = *(result + (109 << 8) + 77) = 77;
         *(result + (78 << 8) + 109) = *(result + (109 << 8) + 78) = 109;
     }
-    return result;
 }
 
+typedef struct
+{
+    byte        **table;
+    int         percent;
+    int         colors;
+} tinttable_t;
+
+static tinttable_t tinttables[] =
+{
+    { &tinttab,           ADDITIVE, ALL            },
+    { &tinttab25,         25,       ALL            },
+    { &tinttab33,         33,       ALL            },
+    { &tinttab40,         40,       ALL            },
+    { &tinttab50,         50,       ALL            },
+    { &tinttab60,         60,       ALL            },
+    { &tinttab66,         66,       ALL            },
+    { &tinttab75,         75,       ALL            },
+    { &tinttab80,         80,       ALL            },
+    { &tinttabred,        ADDITIVE, REDS           },
+    { &tinttabredwhite,   ADDITIVE, REDS | WHITES  },
+    { &tinttabgreen,      ADDITIVE, GREENS         },
+    { &tinttabblue,       ADDITIVE, BLUES          },
+    { &tinttabred50,      50,       REDS           },
+    { &tinttabredwhite50, 50,       REDS | WHITES  },
+    { &tinttabgreen50,    50,       GREENS         },
+    { &tinttabblue50,     50,       BLUES          }
+};
+
+#define NUMTINTTABLES   ((int)arrlen(tinttables))
+
+static byte             tintpalette[768];
+static int              numtintthreads = 1;
+static SDL_Thread       *tintthreads[NUMTINTTABLES];
+
+static int GenerateTintTables(void *data)
+{
+    int i;
+
+    for (i = (int)(intptr_t)data; i < NUMTINTTABLES; i += numtintthreads)
+        GenerateTintTable(*tinttables[i].table, tintpalette, tinttables[i].percent,
+            tinttables[i].colors);
+
+    return 0;
+}
+
+//
+// I_InitTintTables
+// The tables aren't needed until the first frame is drawn, so they are
+// generated in the background while the rest of the game starts up. The
+// memory for them is allocated here, so the pointers are already valid.
+//
 void I_InitTintTables(byte *palette)
 {
-    tinttab = GenerateTintTable(palette, ADDITIVE, ALL);
-
-    tinttab25 = GenerateTintTable(palette, 25, ALL);
-    tinttab33 = GenerateTintTable(palette, 33, ALL);
-    tinttab40 = GenerateTintTable(palette, 40, ALL);
-    tinttab50 = GenerateTintTable(palette, 50, ALL);
-    tinttab60 = GenerateTintTable(palette, 60, ALL);
-    tinttab66 = GenerateTintTable(palette, 66, ALL);
-    tinttab75 = GenerateTintTable(palette, 75, ALL);
-    tinttab80 = GenerateTintTable(palette, 80, ALL);
-
-    tinttabred = GenerateTintTable(palette, ADDITIVE, REDS);
-    tinttabredwhite = GenerateTintTable(palette, ADDITIVE, REDS | WHITES);
-    tinttabgreen = GenerateTintTable(palette, ADDITIVE, GREENS);
-    tinttabblue = GenerateTintTable(palette, ADDITIVE, BLUES);
-
-    tinttabred50 = GenerateTintTable(palette, 50, REDS);
-    tinttabredwhite50 = GenerateTintTable(palette, 50, REDS | WHITES);
-    tinttabgreen50 = GenerateTintTable(palette, 50, GREENS);
-    tinttabblue50 = GenerateTintTable(palette, 50, BLUES);
+    int i;
+
+    memcpy(tintpalette, palette, sizeof(tintpalette));
+
+    for (i = 0; i < NUMTINTTABLES; i++)
+        *tinttables[i].table = (byte *)Z_Malloc(65536, PU_STATIC, NULL);
+
+#ifdef SDL20
+    numtintthreads = MAX(1, MIN(SDL_GetCPUCount(), NUMTINTTABLES));
+
+    for (i = 0; i < numtintthreads; i++)
+        if (!(tintthreads[i] = SDL_CreateThread(GenerateTintTables, "tinttab", (void *)(intptr_t)i)))
+            GenerateTintTables((void *)(intptr_t)i);
+#else
+    GenerateTintTables((void *)0);
+#endif
+}
+
+//
+// I_FinishTintTables
+// Wait for the tables to be generated. Must be called before anything
+// is drawn.
+//
+void I_FinishTintTables(void)
+{
+    int i;
+
+    for (i = 0; i < numtintthreads; i++)
+        if (tintthreads[i])
+        {
+            SDL_WaitThread(tintthreads[i], NULL);
+            tintthreads[i] = NULL;
+        }
 }
@@ -40,5 +40,6 @@
 #define __I_TINTTAB__
 
 void I_InitTintTables(byte *palette);
+void I_FinishTintTables(void);
 
 #endif
@@ -0,0 +1,231 @@
+/*
+========================================================================
+
+                               DOOM RETRO
+         The classic, refined DOOM source port. For Windows PC.
+
+========================================================================
+
+  Copyright (C) 1993-2012 id Software LLC, a ZeniMax Media company.
+  Copyright (C) 2013-2015 Brad Harding.
+
+  DOOM RETRO is a fork of CHOCOLATE DOOM by Simon Howard.
+  For a complete list of credits, see the accompanying AUTHORS file.
+
+  This file is part of DOOM RETRO.
+
+  DOOM RETRO is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by the
+  Free Software Foundation, either version 3 of the License, or (at your
+  option) any later version.
+
+  DOOM RETRO is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DOOM RETRO. If not, see <http://www.gnu.org/licenses/>.
+
+  DOOM is a registered trademark of id Software LLC, a ZeniMax Media
+  company, in the US and/or other countries and is used without
+  permission. All other trademarks are the property of their respective
+  holders. DOOM RETRO is in no way affiliated with nor endorsed by
+  id Software LLC.
+
+========================================================================
+*/
+
+#include <string.h>
+
+#include "m_compress.h"
+
+#define MINMATCH        4
+#define LASTLITERALS    5       // the last 5 bytes are always literals
+#define MFLIMIT         12      // and no match starts in the last 12
+#define MAXDISTANCE     65535
+
+#define HASHBITS        12
+
+static unsigned int ReadLong(byte *p)
+{
+    return (p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24));
+}
+
+static int Hash(unsigned int sequence)
+{
+    return ((sequence * 2654435761u) >> (32 - HASHBITS));
+}
+
+// Write a length that didn't fit in its 4 bits of the token
+static byte *WriteLength(byte *op, int length)
+{
+    for (; length >= 255; length -= 255)
+        *op++ = 255;
+
+    *op++ = length;
+
+    return op;
+}
+
+static byte *WriteLiterals(byte *op, byte *literals, int length, int matchlength)
+{
+    byte        *token = op++;
+
+    if (length >= 15)
+    {
+        *token = 15 << 4;
+        op = WriteLength(op, length - 15);
+    }
+    else
+        *token = length << 4;
+
+    memcpy(op, literals, length);
+    op += length;
+
+    if (matchlength >= 0)
+    {
+        if (matchlength >= 15)
+            *token |= 15;
+        else
+            *token |= matchlength;
+    }
+
+    return op;
+}
+
+//
+// M_Compress
+// Compress srclen bytes into dest, which must have room for
+// M_CompressBound(srclen) bytes. Returns the compressed length.
+//
+int M_Compress(byte *src, int srclen, byte *dest)
+{
+    int         table[1 << HASHBITS];
+    byte        *ip = src;
+    byte        *anchor = src;
+    byte        *mflimit = src + srclen - MFLIMIT;
+    byte        *matchlimit = src + srclen - LASTLITERALS;
+    byte        *op = dest;
+    int         i;
+
+    for (i = 0; i < (1 << HASHBITS); i++)
+        table[i] = -1;
+
+    if (srclen > MFLIMIT)
+        while (ip < mflimit)
+        {
+            unsigned int        sequence = ReadLong(ip);
+            int                 h = Hash(sequence);
+            byte                *ref = (table[h] < 0 ? NULL : src + table[h]);
+            int                 matchlength;
+            int                 offset;
+
+            table[h] = ip - src;
+
+            if (!ref || ip - ref > MAXDISTANCE || ReadLong(ref) != sequence)
+            {
+                ip++;
+                continue;
+            }
+
+            // extend the match as far as it goes
+            matchlength = MINMATCH;
+            while (ip + matchlength < matchlimit && ref[matchlength] == ip[matchlength])
+                matchlength++;
+
+            offset = ip - ref;
+            op = WriteLiterals(op, anchor, ip - anchor, matchlength - MINMATCH);
+            *op++ = offset & 0xFF;
+            *op++ = offset >> 8;
+            if (matchlength - MINMATCH >= 15)
+                op = WriteLength(op, matchlength - MINMATCH - 15);
+
+            ip += matchlength;
+            anchor = ip;
+        }
+
+    // whatever is left over is literals
+    op = WriteLiterals(op, anchor, src + srclen - anchor, -1);
+
+    return (op - dest);
+}
+
+//
+// M_Decompress
+// Decompress srclen bytes into exactly destlen bytes. Returns false if
+// the compressed data is corrupt.
+//
+boolean M_Decompress(byte *src, int srclen, byte *dest, int destlen)
+{
+    byte        *ip = src;
+    byte        *iend = src + srclen;
+    byte        *op = dest;
+    byte        *oend = dest + destlen;
+
+    while (ip < iend)
+    {
+        int     token = *ip++;
+        int     length = token >> 4;
+        int     offset;
+        byte    *ref;
+
+        if (length == 15)
+        {
+            int s;
+
+            do
+            {
+                if (ip >= iend)
+                    return false;
+                s = *ip++;
+                length += s;
+            } while (s == 255);
+        }
+
+        if (length > iend - ip || length > oend - op)
+            return false;
+
+        memcpy(op, ip, length);
+        ip += length;
+        op += length;
+
+        // the last sequence has no match
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return false;
+
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        ref = op - offset;
+
+        if (!offset || ref < dest)
+            return false;
+
+        length = (token & 15);
+        if (length == 15)
+        {
+            int s;
+
+            do
+            {
+                if (ip >= iend)
+                    return false;
+                s = *ip++;
+                length += s;
+            } while (s == 255);
+        }
+        length += MINMATCH;
+
+        if (length > oend - op)
+            return false;
+
+        // matches can overlap what they're copying, so copy bytewise
+        while (length--)
+            *op++ = *ref++;
+    }
+
+    return (op == oend);
+}
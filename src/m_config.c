@@ -36,6 +36,8 @@
 ========================================================================
 */
 
+#include <time.h>
+
 #ifdef WIN32
 #include <ShlObj.h>
 #include <Xinput.h>
@@ -160,6 +162,7 @@ extern int      selectedskilllevel;
 extern boolean  shadows;
 extern int      smoketrails;
 extern int      snd_maxslicetime_ms;
+extern boolean  snd_softmixer;
 extern char     *version;
 extern char     *timidity_cfg_path;
 extern boolean  translucency;
@@ -212,6 +215,10 @@ typedef struct
     default_t           *defaults;
     int                 numdefaults;
     char                *filename;
+
+    // Defaults hashed by name, chained through next[]
+    int                 *hash;
+    int                 *next;
 } default_collection_t;
 
 typedef struct
@@ -346,6 +353,7 @@ static default_t doom_defaults_list[] =
     CONFIG_VARIABLE_INT          (skilllevel,                 selectedskilllevel,           10),
     CONFIG_VARIABLE_INT          (smoketrails,                smoketrails,                  13),
     CONFIG_VARIABLE_INT          (snd_maxslicetime_ms,        snd_maxslicetime_ms,           0),
+    CONFIG_VARIABLE_INT          (snd_softmixer,              snd_softmixer,                 1),
     CONFIG_VARIABLE_STRING       (timidity_cfg_path,          timidity_cfg_path,             0),
     CONFIG_VARIABLE_INT          (translucency,               translucency,                  1),
     CONFIG_VARIABLE_STRING       (version,                    version,                       0),
@@ -362,6 +370,8 @@ static default_collection_t doom_defaults =
 {
     doom_defaults_list,
     arrlen(doom_defaults_list),
+    NULL,
+    NULL,
     NULL
 };
 
@@ -706,14 +716,56 @@ static char *striptrailingzero(float value)
     return result;
 }
 
+// Returns true if two files have exactly the same contents
+static boolean FilesMatch(char *filename1, char *filename2)
+{
+    FILE        *f1;
+    FILE        *f2;
+    boolean     result = false;
+
+    if (!(f1 = fopen(filename1, "rb")))
+        return false;
+
+    if ((f2 = fopen(filename2, "rb")))
+    {
+        char    buffer1[4096];
+        char    buffer2[4096];
+
+        while (1)
+        {
+            size_t      length1 = fread(buffer1, 1, sizeof(buffer1), f1);
+            size_t      length2 = fread(buffer2, 1, sizeof(buffer2), f2);
+
+            if (length1 != length2 || memcmp(buffer1, buffer2, length1))
+                break;
+
+            if (length1 < sizeof(buffer1))
+            {
+                result = true;
+                break;
+            }
+        }
+
+        fclose(f2);
+    }
+
+    fclose(f1);
+    return result;
+}
+
 static void SaveDefaultCollection(default_collection_t *collection)
 {
     default_t   *defaults;
     int         i;
-    FILE        *f = fopen(collection->filename, "w");
+    boolean     failed;
+    char        *tempname = M_StringJoin(collection->filename, ".tmp", NULL);
+    FILE        *f = fopen(tempname, "w");
 
     if (!f)
+    {
+        free(tempname);
         return; // can't write the file, but don't complain
+    }
 
     defaults = collection->defaults;
 
@@ -898,7 +950,19 @@ static void SaveDefaultCollection(default_collection_t *collection)
         fprintf(f, "\n");
     }
 
-    fclose(f);
+    failed = (ferror(f) != 0);
+    if (fclose(f))
+        failed = true;
+
+    // The config is written to a temporary file first, which then replaces
+    // the old one in one step, so a crash part way through saving can never
+    // leave it truncated. If nothing has changed, the old one is left alone
+    // so its timestamp still matches its cache.
+    if (failed || FilesMatch(tempname, collection->filename)
+        || !M_RenameFile(tempname, collection->filename))
+        remove(tempname);
+
+    free(tempname);
 }
 
 // Parses integer values in the configuration file
@@ -942,6 +1006,304 @@ static float ParseFloatParameter(char *strparm, int set)
     return (float)atof(strparm);
 }
 
+static unsigned int DefaultHash(char *name)
+{
+    unsigned int        hash = 5381;
+
+    while (*name)
+        hash = ((hash << 5) + hash) ^ (unsigned char)*name++;
+
+    return hash;
+}
+
+static void HashDefaultCollection(default_collection_t *collection)
+{
+    int i;
+    int numdefaults = collection->numdefaults;
+
+    collection->hash = malloc(numdefaults * sizeof(int));
+    collection->next = malloc(numdefaults * sizeof(int));
+
+    for (i = 0; i < numdefaults; ++i)
+        collection->hash[i] = -1;
+
+    // add them backwards, so each chain is in the same order as the list
+    for (i = numdefaults - 1; i >= 0; --i)
+    {
+        unsigned int    hash = DefaultHash(collection->defaults[i].name) % numdefaults;
+
+        collection->next[i] = collection->hash[hash];
+        collection->hash[hash] = i;
+    }
+}
+
+static int FindDefault(default_collection_t *collection, char *name)
+{
+    int i;
+
+    for (i = collection->hash[DefaultHash(name) % collection->numdefaults]; i >= 0;
+        i = collection->next[i])
+        if (!strcmp(name, collection->defaults[i].name))
+            return i;
+
+    return -1;
+}
+
+//
+// Config cache
+// A binary snapshot of the defaults read from the config file, which is
+// loaded instead of parsing the config file again as long as the config
+// file's timestamp and size, and the list of defaults and aliases they
+// were parsed with, haven't changed since it was written.
+//
+#define CONFIGCACHEMAGIC        "DRCFGC01"
+
+typedef struct
+{
+    char                magic[8];
+    unsigned int        signature;
+    unsigned int        checksum;
+    int64_t             mtime;
+    int64_t             size;
+    int                 numentries;
+    int                 length;
+} configcache_t;
+
+static unsigned int CacheChecksum(byte *data, int length)
+{
+    unsigned int        checksum = 5381;
+
+    while (length--)
+        checksum = ((checksum << 5) + checksum) ^ *data++;
+
+    return checksum;
+}
+
+// Anything that changes what a config file parses to changes the signature
+static unsigned int CacheSignature(default_collection_t *collection)
+{
+    unsigned int        signature = DefaultHash(PACKAGE_VERSIONSTRING);
+    int                 i;
+
+    for (i = 0; i < collection->numdefaults; ++i)
+        signature = signature * 31 + DefaultHash(collection->defaults[i].name)
+            + collection->defaults[i].type + collection->defaults[i].set;
+
+    for (i = 0; alias[i].text[0]; ++i)
+        signature = signature * 31 + DefaultHash(alias[i].text) + alias[i].value
+            + alias[i].set;
+
+    for (i = 0; i < 128; ++i)
+        signature = signature * 31 + scantokey[i];
+
+    return signature;
+}
+
+static int CacheEntryLength(default_t *def)
+{
+    switch (def->type)
+    {
+        case DEFAULT_STRING:
+            return (2 * sizeof(int) + strlen(*(char **)def->location));
+
+        case DEFAULT_KEY:
+            return (4 * sizeof(int));
+
+        default:
+            return (2 * sizeof(int));
+    }
+}
+
+static void SaveDefaultCache(default_collection_t *collection, boolean *loaded,
+    int64_t mtime, int64_t size)
+{
+    configcache_t       header;
+    int                 i;
+    int                 length = 0;
+    byte                *data;
+    byte                *p;
+    char                *cachename;
+    char                *tempname;
+
+    // timestamps are only to the second, so don't cache a config file that
+    // has just been written, in case it's written again in the same second
+    if (mtime >= (int64_t)time(NULL))
+        return;
+
+    memcpy(header.magic, CONFIGCACHEMAGIC, sizeof(header.magic));
+    header.signature = CacheSignature(collection);
+    header.mtime = mtime;
+    header.size = size;
+    header.numentries = 0;
+
+    for (i = 0; i < collection->numdefaults; ++i)
+        if (loaded[i])
+        {
+            length += CacheEntryLength(&collection->defaults[i]);
+            header.numentries++;
+        }
+
+    header.length = length;
+    data = malloc(sizeof(header) + length);
+    p = data + sizeof(header);
+
+    for (i = 0; i < collection->numdefaults; ++i)
+    {
+        default_t       *def = &collection->defaults[i];
+
+        if (!loaded[i])
+            continue;
+
+        memcpy(p, &i, sizeof(int));
+        p += sizeof(int);
+
+        switch (def->type)
+        {
+            case DEFAULT_STRING:
+            {
+                int     len = strlen(*(char **)def->location);
+
+                memcpy(p, &len, sizeof(int));
+                memcpy(p + sizeof(int), *(char **)def->location, len);
+                p += sizeof(int) + len;
+                break;
+            }
+
+            case DEFAULT_KEY:
+                memcpy(p, &def->untranslated, sizeof(int));
+                memcpy(p + sizeof(int), &def->original_translated, sizeof(int));
+                p += 2 * sizeof(int);
+
+                // fall through
+
+            default:
+                // ints and floats are both copied as they are
+                memcpy(p, def->location, sizeof(int));
+                p += sizeof(int);
+                break;
+        }
+    }
+
+    header.checksum = CacheChecksum(data + sizeof(header), length);
+    memcpy(data, &header, sizeof(header));
+
+    cachename = M_StringJoin(collection->filename, ".cache", NULL);
+    tempname = M_StringJoin(cachename, ".tmp", NULL);
+
+    if (!M_WriteFile(tempname, data, sizeof(header) + length)
+        || !M_RenameFile(tempname, cachename))
+        remove(tempname);
+
+    free(tempname);
+    free(cachename);
+    free(data);
+}
+
+// Walk through the entries in a config cache, checking that each one is
+// valid, and if apply is true, setting the defaults from them
+static boolean ReadDefaultCache(default_collection_t *collection, byte *data,
+    int length, int numentries, boolean apply)
+{
+    byte        *end = data + length;
+
+    while (numentries--)
+    {
+        int             i;
+        default_t       *def;
+
+        if (end - data < (int)sizeof(int))
+            return false;
+
+        memcpy(&i, data, sizeof(int));
+        if (i < 0 || i >= collection->numdefaults)
+            return false;
+
+        def = &collection->defaults[i];
+        if (end - data < (def->type == DEFAULT_STRING ? 2 * (int)sizeof(int) : CacheEntryLength(def)))
+            return false;
+        data += sizeof(int);
+
+        switch (def->type)
+        {
+            case DEFAULT_STRING:
+            {
+                int     len;
+
+                memcpy(&len, data, sizeof(int));
+                data += sizeof(int);
+                if (len < 0 || end - data < len)
+                    return false;
+
+                if (apply)
+                {
+                    char        *s = malloc(len + 1);
+
+                    memcpy(s, data, len);
+                    s[len] = '\0';
+                    *(char **)def->location = s;
+                }
+                data += len;
+                break;
+            }
+
+            case DEFAULT_KEY:
+                if (apply)
+                {
+                    memcpy(&def->untranslated, data, sizeof(int));
+                    memcpy(&def->original_translated, data + sizeof(int), sizeof(int));
+                }
+                data += 2 * sizeof(int);
+
+                // fall through
+
+            default:
+                if (apply)
+                    memcpy(def->location, data, sizeof(int));
+                data += sizeof(int);
+                break;
+        }
+    }
+
+    return (data == end);
+}
+
+static boolean LoadDefaultCache(default_collection_t *collection, int64_t mtime,
+    int64_t size)
+{
+    char                *cachename = M_StringJoin(collection->filename, ".cache", NULL);
+    FILE                *f = fopen(cachename, "rb");
+    configcache_t       header;
+    byte                *data;
+    boolean             result = false;
+
+    free(cachename);
+
+    if (!f)
+        return false;
+
+    if (fread(&header, sizeof(header), 1, f) != 1
+        || memcmp(header.magic, CONFIGCACHEMAGIC, sizeof(header.magic))
+        || header.mtime != mtime || header.size != size
+        || header.signature != CacheSignature(collection)
+        || header.length < 0 || header.length != M_FileLength(f) - (long)sizeof(header))
+    {
+        fclose(f);
+        return false;
+    }
+
+    data = malloc(header.length + 1);
+
+    // only set any defaults once every entry has been checked
+    if (fread(data, 1, header.length, f) == (size_t)header.length
+        && CacheChecksum(data, header.length) == header.checksum
+        && ReadDefaultCache(collection, data, header.length, header.numentries, false))
+        result = ReadDefaultCache(collection, data, header.length, header.numentries, true);
+
+    free(data);
+    fclose(f);
+    return result;
+}
+
 static void LoadDefaultCollection(default_collection_t *collection)
 {
     default_t   *defaults = collection->defaults;
@@ -949,6 +1311,20 @@ static void LoadDefaultCollection(default_collection_t *collection)
     FILE        *f;
     char        defname[80];
     char        strparm[100];
+    int64_t     mtime;
+    int64_t     size;
+    boolean     *loaded;
+
+    if (!M_FileTimeStamp(collection->filename, &mtime, &size))
+        // File not found, but don't complain
+        return;
+
+    if (!collection->hash)
+        HashDefaultCollection(collection);
+
+    // use the cache if the config file hasn't changed since it was written
+    if (LoadDefaultCache(collection, mtime, size))
+        return;
 
     // read the file in, overriding any set defaults
     f = fopen(collection->filename, "r");
@@ -957,8 +1333,14 @@ static void LoadDefaultCollection(default_collection_t *collection)
         // File not opened, but don't complain
         return;
 
+    loaded = calloc(collection->numdefaults, sizeof(boolean));
+
     while (!feof(f))
     {
+        default_t   *def;
+        char        *s;
+        int         intparm;
+
         if (fscanf(f, "%79s %[^\n]\n", defname, strparm) != 2)
             // This line doesn't match
             continue;
@@ -969,65 +1351,61 @@ static void LoadDefaultCollection(default_collection_t *collection)
             strparm[strlen(strparm) - 1] = '\0';
 
         // Find the setting in the list
-        for (i = 0; i < collection->numdefaults; ++i)
+        if ((i = FindDefault(collection, defname)) < 0)
+            continue;
+
+        def = &defaults[i];
+        loaded[i] = true;
+
+        // parameter found
+        switch (def->type)
         {
-            default_t   *def = &collection->defaults[i];
-            char        *s;
-            int         intparm;
+            case DEFAULT_STRING:
+                s = strdup(strparm + 1);
+                s[strlen(s) - 1] = '\0';
+                *(char **)def->location = s;
+                break;
 
-            if (strcmp(defname, def->name) != 0)
-                continue;       // not this one
+            case DEFAULT_INT:
+            case DEFAULT_INT_HEX:
+                *(int *)def->location = ParseIntParameter(strparm, def->set);
+                break;
 
-            // parameter found
-            switch (def->type)
-            {
-                case DEFAULT_STRING:
-                    s = strdup(strparm + 1);
+            case DEFAULT_INT_PERCENT:
+                s = strdup(strparm);
+                if (s[strlen(s) - 1] == '%')
                     s[strlen(s) - 1] = '\0';
-                    *(char **)def->location = s;
-                    break;
-
-                case DEFAULT_INT:
-                case DEFAULT_INT_HEX:
-                    *(int *)def->location = ParseIntParameter(strparm, def->set);
-                    break;
-
-                case DEFAULT_INT_PERCENT:
-                    s = strdup(strparm);
-                    if (s[strlen(s) - 1] == '%')
-                        s[strlen(s) - 1] = '\0';
-                    *(int *)def->location = ParseIntParameter(s, def->set);
-                    break;
-
-                case DEFAULT_KEY:
-                    // translate scancodes read from config
-                    // file (save the old value in untranslated)
-                    intparm = ParseIntParameter(strparm, def->set);
-                    defaults[i].untranslated = intparm;
-                    intparm = (intparm >= 0 && intparm < 128 ? scantokey[intparm] : INVALIDKEY);
-
-                    defaults[i].original_translated = intparm;
-                    *(int *)def->location = intparm;
-                    break;
-
-                case DEFAULT_FLOAT:
-                    *(float *)def->location = ParseFloatParameter(strparm, def->set);
-                    break;
-
-                case DEFAULT_FLOAT_PERCENT:
-                    s = strdup(strparm);
-                    if (s[strlen(s) - 1] == '%')
-                        s[strlen(s) - 1] = '\0';
-                    *(float *)def->location = ParseFloatParameter(strparm, def->set);
-                    break;
-            }
+                *(int *)def->location = ParseIntParameter(s, def->set);
+                break;
 
-            // finish
-            break;
+            case DEFAULT_KEY:
+                // translate scancodes read from config
+                // file (save the old value in untranslated)
+                intparm = ParseIntParameter(strparm, def->set);
+                defaults[i].untranslated = intparm;
+                intparm = (intparm >= 0 && intparm < 128 ? scantokey[intparm] : INVALIDKEY);
+
+                defaults[i].original_translated = intparm;
+                *(int *)def->location = intparm;
+                break;
+
+            case DEFAULT_FLOAT:
+                *(float *)def->location = ParseFloatParameter(strparm, def->set);
+                break;
+
+            case DEFAULT_FLOAT_PERCENT:
+                s = strdup(strparm);
+                if (s[strlen(s) - 1] == '%')
+                    s[strlen(s) - 1] = '\0';
+                *(float *)def->location = ParseFloatParameter(strparm, def->set);
+                break;
         }
     }
 
     fclose(f);
+
+    SaveDefaultCache(collection, loaded, mtime, size);
+    free(loaded);
 }
 
 //
@@ -1364,6 +1742,9 @@ static void M_CheckDefaults(void)
 
     smoketrails = BETWEEN(SMOKETRAILS_MIN, smoketrails, SMOKETRAILS_MAX);
 
+    if (snd_softmixer != false && snd_softmixer != true)
+        snd_softmixer = SND_SOFTMIXER_DEFAULT;
+
     if (translucency != false && translucency != true)
         translucency = TRANSLUCENCY_DEFAULT;
 
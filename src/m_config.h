@@ -294,6 +294,8 @@
 
 #define SND_MAXSLICETIME_MS_DEFAULT             28
 
+#define SND_SOFTMIXER_DEFAULT                   false
+
 #define TIMIDITY_CFG_PATH_DEFAULT               ""
 
 #define TRANSLUCENCY_DEFAULT                    true
@@ -935,16 +935,12 @@ void M_LoadSelect(int choice)
 {
     if (M_CheckSaveGame(choice))
     {
-        char    name[SAVESTRINGSIZE];
-
-        M_StringCopy(name, P_SaveGameFile(choice), sizeof(name));
-
         S_StartSound(NULL, sfx_pistol);
         I_WaitVBL(2 * TICRATE);
         functionkey = 0;
         quickSaveSlot = choice;
         M_ClearMenus();
-        G_LoadGame(name);
+        G_LoadGame(choice);
     }
 }
 
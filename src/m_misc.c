@@ -46,10 +46,10 @@
 #ifdef _MSC_VER
 #include <direct.h>
 #endif
-#else
+#endif
+
 #include <sys/stat.h>
 #include <sys/types.h>
-#endif
 
 #include "doomdef.h"
 #include "m_misc.h"
@@ -68,6 +68,37 @@ void M_MakeDirectory(char *path)
 #endif
 }
 
+//
+// M_RenameFile
+// Rename a file, replacing any file already called newname in one step,
+// so that there's never a moment when neither file exists.
+//
+boolean M_RenameFile(char *oldname, char *newname)
+{
+#ifdef WIN32
+    return (MoveFileEx(oldname, newname, MOVEFILE_REPLACE_EXISTING) != 0);
+#else
+    return !rename(oldname, newname);
+#endif
+}
+
+//
+// M_FileTimeStamp
+// Get the modification time and size of a file, so that anything built
+// from its contents can tell later on if it has been changed since.
+//
+boolean M_FileTimeStamp(char *filename, int64_t *mtime, int64_t *size)
+{
+    struct stat buf;
+
+    if (stat(filename, &buf))
+        return false;
+
+    *mtime = (int64_t)buf.st_mtime;
+    *size = (int64_t)buf.st_size;
+    return true;
+}
+
 // Check if a file exists
 boolean M_FileExists(char *filename)
 {
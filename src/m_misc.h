@@ -49,6 +49,8 @@ int M_ReadFile(char *name, byte **buffer);
 void M_MakeDirectory(char *dir);
 char *M_TempFile(char *s);
 boolean M_FileExists(char *file);
+boolean M_RenameFile(char *oldname, char *newname);
+boolean M_FileTimeStamp(char *filename, int64_t *mtime, int64_t *size);
 long M_FileLength(FILE *handle);
 char *M_ExtractFolder(char *str);
 boolean M_StrToInt(const char *str, int *result);
@@ -46,6 +46,8 @@ int M_Random(void);
 // As M_Random, but used only by the play simulation.
 int P_Random(void);
 
+extern int prndindex;
+
 void M_ClearRandom(void);
 
 int M_RandomInt(int, int);
@@ -42,7 +42,7 @@
 
 #include "memio.h"
 
-#include "z_zone.h"
+#include "i_system.h"
 
 typedef enum {
     MODE_READ,
@@ -57,10 +57,22 @@ struct _MEMFILE {
     memfile_mode_t      mode;
 };
 
+// Memory files don't use the zone, so that they can be used by the
+// music conversion thread.
+static void *mem_alloc(void *ptr, size_t size)
+{
+    void        *result = realloc(ptr, size);
+
+    if (!result)
+        I_Error("mem_alloc: Failure trying to allocate %lu bytes", (unsigned long)size);
+
+    return result;
+}
+
 // Open a memory area for reading
 MEMFILE *mem_fopen_read(void *buf, size_t buflen)
 {
-    MEMFILE     *file = (MEMFILE *)Z_Malloc(sizeof(MEMFILE), PU_STATIC, 0);
+    MEMFILE     *file = (MEMFILE *)mem_alloc(NULL, sizeof(MEMFILE));
 
     file->buf = (unsigned char *) buf;
     file->buflen = buflen;
@@ -96,10 +108,10 @@ size_t mem_fread(void *buf, size_t size, size_t nmemb, MEMFILE *stream)
 // Open a memory area for writing
 MEMFILE *mem_fopen_write(void)
 {
-    MEMFILE     *file = (MEMFILE *)Z_Malloc(sizeof(MEMFILE), PU_STATIC, 0);
+    MEMFILE     *file = (MEMFILE *)mem_alloc(NULL, sizeof(MEMFILE));
 
     file->alloced = 1024;
-    file->buf = (unsigned char *)Z_Malloc(file->alloced, PU_STATIC, 0);
+    file->buf = (unsigned char *)mem_alloc(NULL, file->alloced);
     file->buflen = 0;
     file->position = 0;
     file->mode = MODE_WRITE;
@@ -119,14 +131,12 @@ size_t mem_fwrite(const void *ptr, size_t size, size_t nmemb, MEMFILE *stream)
     // If so, reallocate bigger.
     bytes = size * nmemb;
 
-    while (bytes > stream->alloced - stream->position)
+    if (bytes > stream->alloced - stream->position)
     {
-        unsigned char   *newbuf = (unsigned char *)Z_Malloc(stream->alloced * 2, PU_STATIC, 0);
+        while (bytes > stream->alloced - stream->position)
+            stream->alloced *= 2;
 
-        memcpy(newbuf, stream->buf, stream->alloced);
-        Z_Free(stream->buf);
-        stream->buf = newbuf;
-        stream->alloced *= 2;
+        stream->buf = (unsigned char *)mem_alloc(stream->buf, stream->alloced);
     }
 
     // Copy into buffer
@@ -148,9 +158,9 @@ void mem_get_buf(MEMFILE *stream, void **buf, size_t *buflen)
 void mem_fclose(MEMFILE *stream)
 {
     if (stream->mode == MODE_WRITE)
-        Z_Free(stream->buf);
+        free(stream->buf);
 
-    Z_Free(stream);
+    free(stream);
 }
 
 long mem_ftell(MEMFILE *stream)
@@ -270,12 +270,12 @@ static boolean P_IsOnLift(const mobj_t *actor)
 //
 static int P_IsUnderDamage(mobj_t *actor)
 {
-    const struct msecnode_s     *seclist;
+    int                         seclist;
     const ceiling_t             *cl;    // Crushing ceiling
     int                         dir = 0;
 
-    for (seclist = actor->touching_sectorlist; seclist; seclist = seclist->m_tnext)
-        if ((cl = seclist->m_sector->specialdata)
+    for (seclist = actor->touching_sectorlist; seclist; seclist = P_SecNode(seclist)->m_tnext)
+        if ((cl = P_SecNode(seclist)->m_sector->specialdata)
             && cl->thinker.function.acp1 == (actionf_p1)T_MoveCeiling)
             dir |= cl->direction;
 
@@ -1099,6 +1099,7 @@ void A_SkelMissile(mobj_t *actor)
 
     mo->x += mo->momx;
     mo->y += mo->momy;
+    P_UpdateThingBlockPosition(mo);
     mo->tracer = actor->target;
 }
 
@@ -36,6 +36,8 @@
 ========================================================================
 */
 
+#include <stdlib.h>
+
 #include "doomdata.h"
 #include "doomdef.h"
 #include "p_fix.h"
@@ -990,3 +992,148 @@ thingfix_t thingfix[] =
 
     { -1,               0,   0,     0, 0,                      DEFAULT, DEFAULT, DEFAULT, DEFAULT, DEFAULT,  DEFAULT                          }
 };
+
+typedef struct
+{
+    mapfix_t    *fixes;
+    int         numfixes;
+
+    // the current map's fixes
+    mapfix_t    *first;
+    int         count;
+} mapfixindex_t;
+
+static mapfixindex_t    mapfixindex[NUMFIXTABLES];
+
+static int CompareMapFixes(const void *a, const void *b)
+{
+    const mapfix_t      *fix1 = (const mapfix_t *)a;
+    const mapfix_t      *fix2 = (const mapfix_t *)b;
+
+    if (fix1->mission != fix2->mission)
+        return (fix1->mission - fix2->mission);
+    if (fix1->episode != fix2->episode)
+        return (fix1->episode - fix2->episode);
+    if (fix1->map != fix2->map)
+        return (fix1->map - fix2->map);
+    if (fix1->element != fix2->element)
+        return (fix1->element - fix2->element);
+
+    // keep fixes to the same element in the order they are in the table
+    return (fix1->fix - fix2->fix);
+}
+
+static void AddMapFix(int table, int mission, int episode, int map, int element)
+{
+    mapfixindex_t       *index = &mapfixindex[table];
+    mapfix_t            *fix = &index->fixes[index->numfixes];
+
+    fix->mission = mission;
+    fix->episode = episode;
+    fix->map = map;
+    fix->element = element;
+    fix->fix = index->numfixes++;
+}
+
+//
+// P_InitMapFixes
+// Index all of the fix tables at startup.
+//
+void P_InitMapFixes(void)
+{
+    int i;
+
+    for (i = 0; vertexfix[i].mission != -1; i++);
+    mapfixindex[FIX_VERTEXES].fixes = malloc(i * sizeof(mapfix_t));
+    for (i = 0; vertexfix[i].mission != -1; i++)
+        AddMapFix(FIX_VERTEXES, vertexfix[i].mission, vertexfix[i].epsiode, vertexfix[i].map,
+            vertexfix[i].vertex);
+
+    for (i = 0; linefix[i].mission != -1; i++);
+    mapfixindex[FIX_LINEDEFS].fixes = malloc(i * sizeof(mapfix_t));
+    for (i = 0; linefix[i].mission != -1; i++)
+        AddMapFix(FIX_LINEDEFS, linefix[i].mission, linefix[i].epsiode, linefix[i].map,
+            linefix[i].linedef);
+
+    for (i = 0; sectorfix[i].mission != -1; i++);
+    mapfixindex[FIX_SECTORS].fixes = malloc(i * sizeof(mapfix_t));
+    for (i = 0; sectorfix[i].mission != -1; i++)
+        AddMapFix(FIX_SECTORS, sectorfix[i].mission, sectorfix[i].epsiode, sectorfix[i].map,
+            sectorfix[i].sector);
+
+    for (i = 0; thingfix[i].mission != -1; i++);
+    mapfixindex[FIX_THINGS].fixes = malloc(i * sizeof(mapfix_t));
+    for (i = 0; thingfix[i].mission != -1; i++)
+        AddMapFix(FIX_THINGS, thingfix[i].mission, thingfix[i].epsiode, thingfix[i].map,
+            thingfix[i].thing);
+
+    for (i = 0; i < NUMFIXTABLES; i++)
+        qsort(mapfixindex[i].fixes, mapfixindex[i].numfixes, sizeof(mapfix_t), CompareMapFixes);
+}
+
+//
+// P_SetMapFixes
+// Find the fixes in each table for the map about to be loaded.
+//
+void P_SetMapFixes(int mission, int episode, int map)
+{
+    int i;
+
+    for (i = 0; i < NUMFIXTABLES; i++)
+    {
+        mapfixindex_t   *index = &mapfixindex[i];
+        int             low = 0;
+        int             high = index->numfixes;
+        mapfix_t        *last;
+
+        // find the first fix for the map
+        while (low < high)
+        {
+            int         mid = (low + high) / 2;
+            mapfix_t    *fix = &index->fixes[mid];
+
+            if (fix->mission < mission
+                || (fix->mission == mission && (fix->episode < episode
+                || (fix->episode == episode && fix->map < map))))
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        index->first = &index->fixes[low];
+        last = index->first;
+        while (last < index->fixes + index->numfixes
+            && last->mission == mission && last->episode == episode && last->map == map)
+            last++;
+        index->count = last - index->first;
+    }
+}
+
+//
+// P_GetMapFixes
+// Returns how many of the current map's fixes in a table apply to an
+// element, and points fixes at the first of them.
+//
+int P_GetMapFixes(int table, int element, mapfix_t **fixes)
+{
+    mapfixindex_t       *index = &mapfixindex[table];
+    int                 low = 0;
+    int                 high = index->count;
+    int                 count = 0;
+
+    while (low < high)
+    {
+        int     mid = (low + high) / 2;
+
+        if (index->first[mid].element < element)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    *fixes = &index->first[low];
+    while (low + count < index->count && index->first[low + count].element == element)
+        count++;
+
+    return count;
+}
@@ -119,4 +119,31 @@ extern thingfix_t thingfix[];
 #pragma pack(pop)
 #endif
 
+//
+// The fixes in each table are indexed by map, and then by the vertex,
+// linedef, sector or thing they apply to, so that only the current map's
+// fixes need to be looked at when it is loaded.
+//
+enum
+{
+    FIX_VERTEXES,
+    FIX_LINEDEFS,
+    FIX_SECTORS,
+    FIX_THINGS,
+    NUMFIXTABLES
+};
+
+typedef struct
+{
+    int         mission;
+    int         episode;
+    int         map;
+    int         element;        // vertex, linedef, sector or thing
+    int         fix;            // index into the table
+} mapfix_t;
+
+void P_InitMapFixes(void);
+void P_SetMapFixes(int mission, int episode, int map);
+int P_GetMapFixes(int table, int element, mapfix_t **fixes);
+
 #endif
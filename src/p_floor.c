@@ -67,10 +67,10 @@ result_e T_MovePlane(sector_t *sector, fixed_t speed, fixed_t dest,
                     {
                         lastpos = sector->floorheight;
                         sector->floorheight = dest;
-                        if (P_ChangeSector(sector, crush))
+                        if (P_ChangeSector(sector, crush, floorOrCeiling, lastpos))
                         {
                             sector->floorheight = lastpos;
-                            P_ChangeSector(sector, crush);
+                            P_ChangeSector(sector, crush, floorOrCeiling, dest);
                         }
                         return pastdest;
                     }
@@ -78,7 +78,7 @@ result_e T_MovePlane(sector_t *sector, fixed_t speed, fixed_t dest,
                     {
                         lastpos = sector->floorheight;
                         sector->floorheight -= speed;
-                        P_ChangeSector(sector, crush);
+                        P_ChangeSector(sector, crush, floorOrCeiling, lastpos);
                     }
                     break;
 
@@ -89,10 +89,10 @@ result_e T_MovePlane(sector_t *sector, fixed_t speed, fixed_t dest,
                     {
                         lastpos = sector->floorheight;
                         sector->floorheight = dest;
-                        if (P_ChangeSector(sector, crush))
+                        if (P_ChangeSector(sector, crush, floorOrCeiling, lastpos))
                         {
                             sector->floorheight = lastpos;
-                            P_ChangeSector(sector, crush);
+                            P_ChangeSector(sector, crush, floorOrCeiling, dest);
                         }
                         return pastdest;
                     }
@@ -101,10 +101,10 @@ result_e T_MovePlane(sector_t *sector, fixed_t speed, fixed_t dest,
                         // COULD GET CRUSHED
                         lastpos = sector->floorheight;
                         sector->floorheight += speed;
-                        if (P_ChangeSector(sector, crush))
+                        if (P_ChangeSector(sector, crush, floorOrCeiling, lastpos))
                         {
                             sector->floorheight = lastpos;
-                            P_ChangeSector(sector, crush);
+                            P_ChangeSector(sector, crush, floorOrCeiling, lastpos + speed);
                             return crushed;
                         }
                     }
@@ -123,10 +123,10 @@ result_e T_MovePlane(sector_t *sector, fixed_t speed, fixed_t dest,
                     {
                         lastpos = sector->ceilingheight;
                         sector->ceilingheight = dest;
-                        if (P_ChangeSector(sector, crush))
+                        if (P_ChangeSector(sector, crush, floorOrCeiling, lastpos))
                         {
                             sector->ceilingheight = lastpos;
-                            P_ChangeSector(sector, crush);
+                            P_ChangeSector(sector, crush, floorOrCeiling, dest);
                         }
                         return pastdest;
                     }
@@ -135,12 +135,12 @@ result_e T_MovePlane(sector_t *sector, fixed_t speed, fixed_t dest,
                         // COULD GET CRUSHED
                         lastpos = sector->ceilingheight;
                         sector->ceilingheight -= speed;
-                        if (P_ChangeSector(sector, crush))
+                        if (P_ChangeSector(sector, crush, floorOrCeiling, lastpos))
                         {
                             if (crush)
                                 return crushed;
                             sector->ceilingheight = lastpos;
-                            P_ChangeSector(sector, crush);
+                            P_ChangeSector(sector, crush, floorOrCeiling, lastpos - speed);
                             return crushed;
                         }
                     }
@@ -152,10 +152,10 @@ result_e T_MovePlane(sector_t *sector, fixed_t speed, fixed_t dest,
                     {
                         lastpos = sector->ceilingheight;
                         sector->ceilingheight = dest;
-                        if (P_ChangeSector(sector, crush))
+                        if (P_ChangeSector(sector, crush, floorOrCeiling, lastpos))
                         {
                             sector->ceilingheight = lastpos;
-                            P_ChangeSector(sector, crush);
+                            P_ChangeSector(sector, crush, floorOrCeiling, dest);
                         }
                         return pastdest;
                     }
@@ -163,7 +163,7 @@ result_e T_MovePlane(sector_t *sector, fixed_t speed, fixed_t dest,
                     {
                         lastpos = sector->ceilingheight;
                         sector->ceilingheight += speed;
-                        P_ChangeSector(sector, crush);
+                        P_ChangeSector(sector, crush, floorOrCeiling, lastpos);
                     }
                     break;
             }
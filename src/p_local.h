@@ -201,7 +201,10 @@ extern fixed_t          lowfloor;
 void P_LineOpening(line_t *linedef);
 
 boolean P_BlockLinesIterator(int x, int y, boolean(*func)(line_t *));
+boolean P_BlockLinesBoxIterator(int x, int y, fixed_t *bbox, boolean(*func)(line_t *));
 boolean P_BlockThingsIterator(int x, int y, boolean(*func)(mobj_t *));
+boolean P_BlockThingsNearIterator(int x, int y, fixed_t tx, fixed_t ty, fixed_t range,
+                                  boolean(*func)(mobj_t *));
 
 #define PT_ADDLINES     1
 #define PT_ADDTHINGS    2
@@ -214,6 +217,7 @@ boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags
 
 void P_UnsetThingPosition(mobj_t *thing);
 void P_SetThingPosition(mobj_t *thing);
+void P_UpdateThingBlockPosition(mobj_t *thing);
 
 //
 // P_MAP
@@ -242,9 +246,18 @@ void P_SlideMove(mobj_t *mo);
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
 void P_UseLines(player_t *player);
 
-boolean P_ChangeSector(sector_t *sector, boolean crunch);
+boolean P_ChangeSector(sector_t *sector, boolean crunch, int floorOrCeiling, fixed_t oldheight);
+void P_InitSecNodeList(int numthings);
 void P_FreeSecNodeList(void);
 
+// msecnode_ts are allocated in chunks of this many
+#define SECNODECHUNKSHIFT       9
+#define SECNODECHUNKSIZE        (1 << SECNODECHUNKSHIFT)
+
+extern msecnode_t       **secnodes;
+
+#define P_SecNode(i)            (&secnodes[(i) >> SECNODECHUNKSHIFT][(i) & (SECNODECHUNKSIZE - 1)])
+
 extern mobj_t           *linetarget;    // who got hit (or NULL)
 
 fixed_t P_AimLineAttack(mobj_t *t1, angle_t angle, fixed_t distance);
@@ -268,7 +281,39 @@ extern int              bmapwidth;
 extern int              bmapheight;     // in mapblocks
 extern fixed_t          bmaporgx;
 extern fixed_t          bmaporgy;       // origin of block map
-extern mobj_t           **blocklinks;   // for thing chains
+
+// Lines in each mapblock, with what's needed to clip against
+// them copied out of line_t so a block can be scanned in order.
+typedef struct
+{
+    fixed_t             bbox[4];
+    fixed_t             x1, y1;
+    fixed_t             x2, y2;
+    fixed_t             dx, dy;
+    slopetype_t         slopetype;
+    int                 linenum;
+} blockline_t;
+
+extern blockline_t      *blocklines;
+extern int              *blocklinesindex;       // first blockline of each mapblock
+extern int              *linevalidcount;        // if == validcount, already checked
+
+// Things in each mapblock, kept as packed arrays so that
+// a block can be scanned without dereferencing every mobj_t.
+// Entries are in link order; removed entries are left as NULL
+// while the block is being iterated over and compacted later.
+typedef struct
+{
+    int                 count;
+    int                 max;
+    int                 holes;
+    fixed_t             *x;
+    fixed_t             *y;
+    fixed_t             *radius;
+    mobj_t              **mobj;
+} blockthings_t;
+
+extern blockthings_t    *blockthings;   // for thing chains
 
 //
 // P_INTER
@@ -85,7 +85,7 @@ int             numspechit;
 angle_t         shootangle;     // [BH] angle of blood and puffs for automap
 
 // Temporary holder for thing_sectorlist threads
-msecnode_t      *sector_list = NULL;    // phares 3/16/98
+int             sector_list;            // phares 3/16/98
 
 boolean         infight;
 
@@ -188,7 +188,7 @@ boolean P_TeleportMove(mobj_t *thing, fixed_t x, fixed_t y, fixed_t z, boolean b
 
     for (bx = xl; bx <= xh; bx++)
         for (by = yl; by <= yh; by++)
-            if (!P_BlockThingsIterator(bx, by, PIT_StompThing))
+            if (!P_BlockThingsNearIterator(bx, by, x, y, radius, PIT_StompThing))
                 return false;
 
     // the move is ok,
@@ -282,18 +282,10 @@ static int untouched(line_t *ld)
 //
 // PIT_CheckLine
 // Adjusts tmfloorz and tmceilingz as lines are contacted
+// Only called by P_BlockLinesBoxIterator() for lines that cross tmbbox.
 //
 static boolean PIT_CheckLine(line_t *ld)
 {
-    if (tmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
-        || tmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
-        || tmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
-        || tmbbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
-        return true;                                    // didn't hit it
-
-    if (P_BoxOnLineSide(tmbbox, ld) != -1)
-        return true;                                    // didn't hit it
-
     // A line has been hit
 
     // The moving thing's destination position will cross the given line.
@@ -666,6 +658,8 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
     // because mobj_ts are grouped into mapblocks
     // based on their origin point, and can overlap
     // into adjacent blocks by up to MAXRADIUS units.
+    // Pickups are touched within 20 units whatever
+    // their radius, so allow for that when filtering.
     xl = (tmbbox[BOXLEFT] - bmaporgx - MAXRADIUS) >> MAPBLOCKSHIFT;
     xh = (tmbbox[BOXRIGHT] - bmaporgx + MAXRADIUS) >> MAPBLOCKSHIFT;
     yl = (tmbbox[BOXBOTTOM] - bmaporgy - MAXRADIUS) >> MAPBLOCKSHIFT;
@@ -673,7 +667,7 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
 
     for (bx = xl; bx <= xh; bx++)
         for (by = yl; by <= yh; by++)
-            if (!P_BlockThingsIterator(bx, by, PIT_CheckThing))
+            if (!P_BlockThingsNearIterator(bx, by, x, y, radius + 20 * FRACUNIT, PIT_CheckThing))
                 return false;
 
     // check lines
@@ -684,7 +678,7 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
 
     for (bx = xl; bx <= xh; bx++)
         for (by = yl; by <= yh; by++)
-            if (!P_BlockLinesIterator(bx, by, PIT_CheckLine))
+            if (!P_BlockLinesBoxIterator(bx, by, tmbbox, PIT_CheckLine))
                 return false;
 
     return true;
@@ -741,7 +735,7 @@ mobj_t *P_CheckOnmobj(mobj_t * thing)
 
     for (bx = xl; bx <= xh; bx++)
         for (by = yl; by <= yh; by++)
-            if (!P_BlockThingsIterator(bx, by, PIT_CheckOnmobjZ))
+            if (!P_BlockThingsNearIterator(bx, by, x, y, radius, PIT_CheckOnmobjZ))
             {
                 *tmthing = oldmo;
                 return onmobj;
@@ -1752,7 +1746,7 @@ void P_RadiusAttack(mobj_t *spot, mobj_t *source, int damage)
 
     for (y = yl; y <= yh; y++)
         for (x = xl; x <= xh; x++)
-            P_BlockThingsIterator(x, y, PIT_RadiusAttack);
+            P_BlockThingsNearIterator(x, y, spot->x, spot->y, damage << FRACBITS, PIT_RadiusAttack);
 }
 
 //
@@ -1773,8 +1767,39 @@ static boolean  nofit;
 static boolean  isliquidsector;
 static fixed_t  floorheight;
 
+// the plane that moved, and the range of heights it swept through
+static boolean  floormoved;
+static fixed_t  planelow;
+static fixed_t  planehigh;
+
 void (*P_BloodSplatSpawner)(fixed_t, fixed_t, int, int);
 
+//
+// P_PlaneMissesThing
+// Returns true if the plane's move can't have changed the thing's floorz,
+// ceilingz or dropoffz, so P_ThingHeightClip() would leave it as it is.
+// A floor only counts if it was between dropoffz and floorz before and
+// after it moved, and a ceiling only if it stayed above ceilingz. Things
+// that P_CheckPosition() can do something to (pickups, missiles and
+// charging skulls) and things P_ThingHeightClip() adjusts regardless are
+// always clipped.
+//
+static boolean P_PlaneMissesThing(mobj_t *thing)
+{
+    if ((thing->flags & (MF_PICKUP | MF_MISSILE | MF_SKULLFLY))
+        || (thing->flags2 & (MF2_FLOATBOB | MF2_FALLING)))
+        return false;
+
+    // if it doesn't fit now, let P_ThingHeightClip() report that
+    if (thing->ceilingz - thing->floorz < thing->height || thing->z + thing->height > thing->ceilingz)
+        return false;
+
+    if (floormoved)
+        return (planehigh < thing->floorz && planelow > thing->dropoffz);
+    else
+        return (planelow > thing->ceilingz);
+}
+
 //
 // PIT_ChangeSector
 //
@@ -1796,7 +1821,7 @@ boolean PIT_ChangeSector(mobj_t *thing)
             thing->shadow->flags2 &= ~MF2_FEETARECLIPPED;
     }
 
-    if (P_ThingHeightClip(thing))
+    if (P_PlaneMissesThing(thing) || P_ThingHeightClip(thing))
         return true;    // keep checking
 
     // crunch bodies to giblets
@@ -1859,49 +1884,57 @@ boolean PIT_ChangeSector(mobj_t *thing)
     return true;
 }
 
-static void P_UpdateBloodSplat(mobj_t *splat)
-{
-    splat->z = floorheight;
-
-    if (isliquidsector)
-    {
-        P_UnsetThingPosition(splat);
-        ((thinker_t *)splat)->function.acv = (actionf_v)(-1);
-    }
-}
-
-static void P_UpdateShadow(mobj_t *shadow)
-{
-    shadow->z = floorheight;
-}
-
 //
 // P_ChangeSector
 // jff 3/19/98 added to just check monsters on the periphery
 // of a moving sector instead of all in bounding box of the
 // sector. Both more accurate and faster.
 // [BH] renamed from P_CheckSector to P_ChangeSector to replace old one entirely
+// The floor (floorOrCeiling == 0) or ceiling of the sector has just moved
+// from oldheight. Things the move can't affect are passed over.
 //
-boolean P_ChangeSector(sector_t *sector, boolean crunch)
+boolean P_ChangeSector(sector_t *sector, boolean crunch, int floorOrCeiling, fixed_t oldheight)
 {
-    msecnode_t  *n;
+    int         n;
+    fixed_t     newheight;
 
     nofit = false;
     crushchange = crunch;
     isliquidsector = isliquid[sector->floorpic];
     floorheight = sector->floorheight;
 
-    for (n = sector->touching_thinglist; n; n = n->m_snext)     // go through list
+    floormoved = !floorOrCeiling;
+    newheight = (floormoved ? floorheight : sector->ceilingheight);
+    planelow = MIN(oldheight, newheight);
+    planehigh = MAX(oldheight, newheight);
+
+    for (n = sector->touching_thinglist; n; n = P_SecNode(n)->m_snext)  // go through list
     {
-        mobj_t  *mobj = n->m_thing;
-
-        if (mobj)
-            if (mobj->type == MT_BLOODSPLAT)
-                P_UpdateBloodSplat(mobj);
-            else if (mobj->type == MT_SHADOW)
-                P_UpdateShadow(mobj);
-            else if (!(mobj->flags & MF_NOBLOCKMAP))            // jff 4/7/98 don't do these
-                PIT_ChangeSector(mobj);                         // process it
+        mobj_t  *mobj = P_SecNode(n)->m_thing;
+
+        if (!mobj)
+            continue;
+
+        switch (mobj->type)
+        {
+            case MT_BLOODSPLAT:
+                mobj->z = floorheight;
+                if (isliquidsector)
+                {
+                    P_UnsetThingPosition(mobj);
+                    ((thinker_t *)mobj)->function.acv = (actionf_v)(-1);
+                }
+                break;
+
+            case MT_SHADOW:
+                mobj->z = floorheight;
+                break;
+
+            default:
+                if (!(mobj->flags & MF_NOBLOCKMAP))             // jff 4/7/98 don't do these
+                    PIT_ChangeSector(mobj);                     // process it
+                break;
+        }
     }
 
     return nofit;
@@ -1910,30 +1943,64 @@ boolean P_ChangeSector(sector_t *sector, boolean crunch)
 // phares 3/21/98
 //
 // Maintain a freelist of msecnode_t's to reduce memory allocs and frees.
-msecnode_t      *headsecnode = NULL;
+// The nodes are allocated in chunks that are kept from one level to the
+// next, and are linked by their index in the pool. Node 0 isn't used, so
+// that 0 can mean the end of a list.
+msecnode_t      **secnodes;
+static int      numsecnodechunks;
+static int      numsecnodes = 1;
+static int      headsecnode;
+
+static void P_AddSecNodeChunk(void)
+{
+    secnodes = realloc(secnodes, (numsecnodechunks + 1) * sizeof(*secnodes));
+    secnodes[numsecnodechunks++] = malloc(SECNODECHUNKSIZE * sizeof(msecnode_t));
+}
 
+//
+// P_InitSecNodeList
+// Make sure there are enough nodes for a level with numthings things,
+// most of which will touch one or two sectors.
+//
+void P_InitSecNodeList(int numthings)
+{
+    while (numsecnodechunks * SECNODECHUNKSIZE < numthings * 2)
+        P_AddSecNodeChunk();
+}
+
+//
+// P_FreeSecNodeList
+// Return every node to the pool at once. Called before a level is loaded.
+//
 void P_FreeSecNodeList(void)
 {
-    headsecnode = NULL; // this is all thats needed to fix the bug
+    numsecnodes = 1;
+    headsecnode = 0;
 }
 
 // P_GetSecnode() retrieves a node from the freelist. The calling routine
 // should make sure it sets all fields properly.
 //
 // killough 11/98: reformatted
-static msecnode_t *P_GetSecnode(void)
+static int P_GetSecnode(void)
 {
-    msecnode_t  *node;
+    int node = headsecnode;
 
-    return (headsecnode ?
-        node = headsecnode, headsecnode = node->m_snext, node :
-        (msecnode_t *)Z_Malloc(sizeof(*node), PU_LEVEL, NULL));
+    if (node)
+        headsecnode = P_SecNode(node)->m_snext;
+    else
+    {
+        if (numsecnodes >= numsecnodechunks * SECNODECHUNKSIZE)
+            P_AddSecNodeChunk();
+        node = numsecnodes++;
+    }
+    return node;
 }
 
 // P_PutSecnode() returns a node to the freelist.
-static void P_PutSecnode(msecnode_t *node)
+static void P_PutSecnode(int node)
 {
-    node->m_snext = headsecnode;
+    P_SecNode(node)->m_snext = headsecnode;
     headsecnode = node;
 }
 
@@ -1942,88 +2009,92 @@ static void P_PutSecnode(msecnode_t *node)
 // P_AddSecnode() searches the current list to see if this sector is
 // already there. If not, it adds a sector node at the head of the list of
 // sectors this object appears in. This is called when creating a list of
-// nodes that will get linked in later. Returns a pointer to the new node.
+// nodes that will get linked in later. Returns the new node.
 //
 // killough 11/98: reformatted
-static msecnode_t *P_AddSecnode(sector_t *s, mobj_t *thing, msecnode_t *nextnode)
+static int P_AddSecnode(sector_t *s, mobj_t *thing, int nextnode)
 {
-    msecnode_t  *node = nextnode;
+    int         node = nextnode;
+    msecnode_t  *n;
 
     while (node)
     {
-        if (node->m_sector == s)                // Already have a node for this sector?
+        n = P_SecNode(node);
+        if (n->m_sector == s)                   // Already have a node for this sector?
         {
-            node->m_thing = thing;              // Yes. Setting m_thing says 'keep it'.
+            n->m_thing = thing;                 // Yes. Setting m_thing says 'keep it'.
             return nextnode;
         }
-        node = node->m_tnext;
+        node = n->m_tnext;
     }
 
     // Couldn't find an existing node for this sector. Add one at the head
     // of the list.
     node = P_GetSecnode();
+    n = P_SecNode(node);
 
-    node->m_sector = s;                         // sector
-    node->m_thing = thing;                      // mobj
-    node->m_tprev = NULL;                       // prev node on Thing thread
-    node->m_tnext = nextnode;                   // next node on Thing thread
+    n->m_sector = s;                            // sector
+    n->m_thing = thing;                         // mobj
+    n->m_tprev = 0;                             // prev node on Thing thread
+    n->m_tnext = nextnode;                      // next node on Thing thread
 
     if (nextnode)
-        nextnode->m_tprev = node;               // set back link on Thing
+        P_SecNode(nextnode)->m_tprev = node;    // set back link on Thing
 
     // Add new node at head of sector thread starting at s->touching_thinglist
-    node->m_sprev = NULL;                       // prev node on sector thread
-    node->m_snext = s->touching_thinglist;      // next node on sector thread
+    n->m_sprev = 0;                             // prev node on sector thread
+    n->m_snext = s->touching_thinglist;         // next node on sector thread
     if (s->touching_thinglist)
-        node->m_snext->m_sprev = node;
+        P_SecNode(s->touching_thinglist)->m_sprev = node;
     s->touching_thinglist = node;
     return node;
 }
 
 // P_DelSecnode() deletes a sector node from the list of
-// sectors this object appears in. Returns a pointer to the next node
-// on the linked list, or NULL.
+// sectors this object appears in. Returns the next node
+// on the linked list, or 0.
 //
 // killough 11/98: reformatted
-static msecnode_t *P_DelSecnode(msecnode_t *node)
+static int P_DelSecnode(int node)
 {
     if (node)
     {
-        msecnode_t      *tp = node->m_tprev;    // prev node on thing thread
-        msecnode_t      *tn = node->m_tnext;    // next node on thing thread
-        msecnode_t      *sp;                    // prev node on sector thread
-        msecnode_t      *sn;                    // next node on sector thread
+        msecnode_t      *n = P_SecNode(node);
+        int             tp = n->m_tprev;        // prev node on thing thread
+        int             tn = n->m_tnext;        // next node on thing thread
+        int             sp;                     // prev node on sector thread
+        int             sn;                     // next node on sector thread
 
         // Unlink from the Thing thread. The Thing thread begins at
         // sector_list and not from mobj_t->touching_sectorlist.
         if (tp)
-            tp->m_tnext = tn;
+            P_SecNode(tp)->m_tnext = tn;
 
         if (tn)
-            tn->m_tprev = tp;
+            P_SecNode(tn)->m_tprev = tp;
 
         // Unlink from the sector thread. This thread begins at
         // sector_t->touching_thinglist.
-        sp = node->m_sprev;
-        sn = node->m_snext;
+        sp = n->m_sprev;
+        sn = n->m_snext;
 
         if (sp)
-            sp->m_snext = sn;
+            P_SecNode(sp)->m_snext = sn;
         else
-            node->m_sector->touching_thinglist = sn;
+            n->m_sector->touching_thinglist = sn;
 
         if (sn)
-            sn->m_sprev = sp;
+            P_SecNode(sn)->m_sprev = sp;
 
         // Return this node to the freelist
         P_PutSecnode(node);
         return tn;
     }
-    return NULL;
+    return 0;
 }
 
 // Delete an entire sector list
-void P_DelSeclist(msecnode_t *node)
+void P_DelSeclist(int node)
 {
     while (node)
         node = P_DelSecnode(node);
@@ -2036,17 +2107,9 @@ void P_DelSeclist(msecnode_t *node)
 // cross through it. You have already decided that the object is allowed
 // at this location, so don't bother with checking impassable or
 // blocking lines.
+// Only called by P_BlockLinesBoxIterator() for lines that cross tmbbox.
 static boolean PIT_GetSectors(line_t *ld)
 {
-    if (tmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
-        || tmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
-        || tmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
-        || tmbbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
-        return true;
-
-    if (P_BoxOnLineSide(tmbbox, ld) != -1)
-        return true;
-
     // This line crosses through the object.
 
     // Collect the sector(s) from the line and add to the
@@ -2077,7 +2140,7 @@ static boolean PIT_GetSectors(line_t *ld)
 void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
 {
     int         xl, xh, yl, yh, bx, by;
-    msecnode_t  *node = sector_list;
+    int         node = sector_list;
     mobj_t      *saved_tmthing = tmthing;
     fixed_t     saved_tmx = tmx, saved_tmy = tmy;
 
@@ -2087,8 +2150,10 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
     // represent the sectors the Thing has vacated.
     while (node)
     {
-        node->m_thing = NULL;
-        node = node->m_tnext;
+        msecnode_t      *n = P_SecNode(node);
+
+        n->m_thing = NULL;
+        node = n->m_tnext;
     }
 
     tmthing = thing;
@@ -2110,7 +2175,7 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
 
     for (bx = xl; bx <= xh; bx++)
         for (by = yl; by <= yh; by++)
-            P_BlockLinesIterator(bx, by, PIT_GetSectors);
+            P_BlockLinesBoxIterator(bx, by, tmbbox, PIT_GetSectors);
 
     // Add the sector of the (x,y) point to sector_list.
     sector_list = P_AddSecnode(thing->subsector->sector, thing, sector_list);
@@ -2120,14 +2185,16 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
     node = sector_list;
     while (node)
     {
-        if (node->m_thing == NULL)
+        msecnode_t      *n = P_SecNode(node);
+
+        if (n->m_thing == NULL)
         {
             if (node == sector_list)
-                sector_list = node->m_tnext;
+                sector_list = n->m_tnext;
             node = P_DelSecnode(node);
         }
         else
-            node = node->m_tnext;
+            node = n->m_tnext;
     }
 
     // cph -
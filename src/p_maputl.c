@@ -37,10 +37,12 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
+
 #include "m_bbox.h"
 #include "p_local.h"
 
-extern msecnode_t *sector_list; // phares 3/16/98
+extern int sector_list;         // phares 3/16/98
 
 void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y);
 
@@ -188,6 +190,118 @@ void P_LineOpening(line_t *linedef)
 // THING POSITION SETTING
 //
 
+// number of P_BlockThingsIterator() calls currently in progress
+static int      blockthingsiterators;
+
+//
+// P_CompactBlockThings
+// Squeeze out entries left empty while the block was being iterated over,
+// keeping the rest in link order.
+//
+static void P_CompactBlockThings(blockthings_t *block)
+{
+    int i;
+    int count = 0;
+
+    for (i = 0; i < block->count; i++)
+        if (block->mobj[i])
+        {
+            block->x[count] = block->x[i];
+            block->y[count] = block->y[i];
+            block->radius[count] = block->radius[i];
+            block->mobj[count++] = block->mobj[i];
+        }
+    block->count = count;
+    block->holes = 0;
+}
+
+//
+// P_AddBlockThing
+// Append a thing to a mapblock, doubling the block's arrays if necessary.
+//
+static void P_AddBlockThing(blockthings_t *block, mobj_t *thing)
+{
+    int i;
+
+    if (block->holes && !blockthingsiterators)
+        P_CompactBlockThings(block);
+
+    if (block->count == block->max)
+    {
+        int     max = (block->max ? block->max * 2 : 8);
+        byte    *buffer = malloc(max * (3 * sizeof(fixed_t) + sizeof(mobj_t *)));
+        mobj_t  **mobj = (mobj_t **)buffer;
+        fixed_t *x = (fixed_t *)(mobj + max);
+        fixed_t *y = x + max;
+        fixed_t *radius = y + max;
+
+        if (block->count)
+        {
+            memcpy(mobj, block->mobj, block->count * sizeof(*mobj));
+            memcpy(x, block->x, block->count * sizeof(*x));
+            memcpy(y, block->y, block->count * sizeof(*y));
+            memcpy(radius, block->radius, block->count * sizeof(*radius));
+        }
+        free(block->mobj);
+
+        block->mobj = mobj;
+        block->x = x;
+        block->y = y;
+        block->radius = radius;
+        block->max = max;
+    }
+
+    i = block->count++;
+    block->x[i] = thing->x;
+    block->y[i] = thing->y;
+    block->radius[i] = thing->radius;
+    block->mobj[i] = thing;
+}
+
+//
+// P_RemoveBlockThing
+// Take a thing out of a mapblock. If the block is being iterated over,
+// just empty its entry so that the indices of the others don't change.
+//
+static void P_RemoveBlockThing(blockthings_t *block, mobj_t *thing)
+{
+    int i = block->count;
+
+    while (i--)
+        if (block->mobj[i] == thing)
+        {
+            block->mobj[i] = NULL;
+            block->holes++;
+            break;
+        }
+
+    if (!blockthingsiterators)
+        P_CompactBlockThings(block);
+}
+
+//
+// P_UpdateThingBlockPosition
+// Refresh the position kept in the blockmap for a thing that has been
+// nudged without being relinked.
+//
+void P_UpdateThingBlockPosition(mobj_t *thing)
+{
+    if (!(thing->flags & MF_NOBLOCKMAP) && thing->blocknum >= 0)
+    {
+        blockthings_t   *block = &blockthings[thing->blocknum];
+        int             i = block->count;
+
+        while (i--)
+            if (block->mobj[i] == thing)
+            {
+                block->x[i] = thing->x;
+                block->y[i] = thing->y;
+                block->radius[i] = thing->radius;
+                break;
+            }
+    }
+}
+
 //
 // P_UnsetThingPosition
 // Unlinks a thing from block map and sectors.
@@ -222,25 +336,20 @@ void P_UnsetThingPosition(mobj_t *thing)
         // If this Thing is being removed entirely, then the calling
         // routine will clear out the nodes in sector_list.
         sector_list = thing->touching_sectorlist;
-        thing->touching_sectorlist = NULL;              // to be restored by P_SetThingPosition
+        thing->touching_sectorlist = 0;                 // to be restored by P_SetThingPosition
     }
 
     if (!(thing->flags & MF_NOBLOCKMAP))
     {
         // inert things don't need to be in blockmap
         //
-        // killough 8/11/98: simpler scheme using pointers-to-pointers for prev
-        // pointers, allows head node pointers to be treated like everything else
-        //
-        // Also more robust, since it doesn't depend on current position for
-        // unlinking. Old method required computing head node based on position
-        // at time of unlinking, assuming it was the same position as during
-        // linking.
-        mobj_t  *bnext;
-        mobj_t  **bprev = thing->bprev;
-
-        if (bprev && (*bprev = bnext = thing->bnext))   // unlink from block map
-            bnext->bprev = bprev;
+        // Unlinking uses the block recorded when the thing was linked,
+        // so it doesn't depend on the current position.
+        if (thing->blocknum >= 0)                       // unlink from block map
+        {
+            P_RemoveBlockThing(&blockthings[thing->blocknum], thing);
+            thing->blocknum = -1;
+        }
     }
 }
 
@@ -271,7 +380,7 @@ void P_SetThingPosition(mobj_t *thing)
 
         // phares 3/16/98
         //
-        // If sector_list isn't NULL, it has a collection of sector
+        // If sector_list isn't empty, it has a collection of sector
         // nodes that were just removed from this Thing.
 
         // Collect the sectors the object will live in by looking at
@@ -283,7 +392,7 @@ void P_SetThingPosition(mobj_t *thing)
         // added, new sector links are created.
         P_CreateSecNodeList(thing, thing->x, thing->y);
         thing->touching_sectorlist = sector_list;       // Attach to Thing's mobj_t
-        sector_list = NULL;                             // clear for next time
+        sector_list = 0;                                // clear for next time
     }
 
     // link into blockmap
@@ -295,22 +404,11 @@ void P_SetThingPosition(mobj_t *thing)
 
         if (blockx >= 0 && blockx < bmapwidth && blocky >= 0 && blocky < bmapheight)
         {
-            // killough 8/11/98: simpler scheme using pointer-to-pointer prev
-            // pointers, allows head nodes to be treated like everything else
-            mobj_t      **link = &blocklinks[blocky * bmapwidth + blockx];
-            mobj_t      *bnext = *link;
-
-            if ((thing->bnext = bnext))
-                bnext->bprev = &thing->bnext;
-            thing->bprev = link;
-            *link = thing;
+            thing->blocknum = blocky * bmapwidth + blockx;
+            P_AddBlockThing(&blockthings[thing->blocknum], thing);
         }
         else
-        {
-            // thing is off the map
-            thing->bnext = NULL;
-            thing->bprev = NULL;
-        }
+            thing->blocknum = -1;       // thing is off the map
     }
 }
 
@@ -336,19 +434,97 @@ boolean P_BlockLinesIterator(int x, int y, boolean (*func)(line_t *))
         return true;
     else
     {
-        int             offset = blockmapindex[y * bmapwidth + x];
-        const int       *list;
+        int                     block = y * bmapwidth + x;
+        const blockline_t       *bl = &blocklines[blocklinesindex[block]];
+        const blockline_t       *end = &blocklines[blocklinesindex[block + 1]];
 
-        for (list = &blockmaphead[offset]; *list != -1; list++)
+        for (; bl < end; bl++)
         {
-            line_t          *ld = &lines[*list];
+            int         linenum = bl->linenum;
 
-            if (ld->validcount == validcount)
+            if (linevalidcount[linenum] == validcount)
                 continue;       // line has already been checked
 
-            ld->validcount = validcount;
+            linevalidcount[linenum] = validcount;
 
-            if (!func(ld))
+            if (!func(&lines[linenum]))
+                return false;
+        }
+        return true;            // everything was checked
+    }
+}
+
+//
+// P_PointOnBlockLineSide
+// As P_PointOnLineSide, using a line's packed copy.
+//
+static int P_PointOnBlockLineSide(fixed_t x, fixed_t y, const blockline_t *bl)
+{
+    return (!bl->dx ? x <= bl->x1 ? bl->dy > 0 : bl->dy < 0 :
+        !bl->dy ? y <= bl->y1 ? bl->dx < 0 : bl->dx > 0 :
+        FixedMul(y - bl->y1, bl->dx >> FRACBITS) >=
+        FixedMul(bl->dy >> FRACBITS, x - bl->x1));
+}
+
+//
+// P_BoxOnBlockLineSide
+// As P_BoxOnLineSide, using a line's packed copy.
+//
+static int P_BoxOnBlockLineSide(const fixed_t *tmbox, const blockline_t *bl)
+{
+    switch (bl->slopetype)
+    {
+        int     p;
+
+        default:
+        case ST_HORIZONTAL:
+            return ((tmbox[BOXBOTTOM] > bl->y1) == (p = tmbox[BOXTOP] > bl->y1) ?
+                p ^ (bl->dx < 0) : -1);
+        case ST_VERTICAL:
+            return ((tmbox[BOXLEFT] < bl->x1) == (p = tmbox[BOXRIGHT] < bl->x1) ?
+                p ^ (bl->dy < 0) : -1);
+        case ST_POSITIVE:
+            return (P_PointOnBlockLineSide(tmbox[BOXRIGHT], tmbox[BOXBOTTOM], bl) ==
+                (p = P_PointOnBlockLineSide(tmbox[BOXLEFT], tmbox[BOXTOP], bl)) ? p : -1);
+        case ST_NEGATIVE:
+            return ((P_PointOnBlockLineSide(tmbox[BOXLEFT], tmbox[BOXBOTTOM], bl)) ==
+                (p = P_PointOnBlockLineSide(tmbox[BOXRIGHT], tmbox[BOXTOP], bl)) ? p : -1);
+    }
+}
+
+//
+// P_BlockLinesBoxIterator
+// As P_BlockLinesIterator, but only calls func for lines that
+// cross bbox. The tests are made on the lines' packed copies,
+// so lines that are missed are never dereferenced.
+//
+boolean P_BlockLinesBoxIterator(int x, int y, fixed_t *bbox, boolean (*func)(line_t *))
+{
+    if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
+        return true;
+    else
+    {
+        int                     block = y * bmapwidth + x;
+        const blockline_t       *bl = &blocklines[blocklinesindex[block]];
+        const blockline_t       *end = &blocklines[blocklinesindex[block + 1]];
+
+        for (; bl < end; bl++)
+        {
+            int         linenum = bl->linenum;
+
+            if (linevalidcount[linenum] == validcount)
+                continue;       // line has already been checked
+
+            linevalidcount[linenum] = validcount;
+
+            if ((bbox[BOXRIGHT] <= bl->bbox[BOXLEFT]) | (bbox[BOXLEFT] >= bl->bbox[BOXRIGHT])
+                | (bbox[BOXTOP] <= bl->bbox[BOXBOTTOM]) | (bbox[BOXBOTTOM] >= bl->bbox[BOXTOP]))
+                continue;       // didn't hit it
+
+            if (P_BoxOnBlockLineSide(bbox, bl) != -1)
+                continue;       // didn't hit it
+
+            if (!func(&lines[linenum]))
                 return false;
         }
         return true;            // everything was checked
@@ -357,18 +533,90 @@ boolean P_BlockLinesIterator(int x, int y, boolean (*func)(line_t *))
 
 //
 // P_BlockThingsIterator
+// Things are visited from the most recently linked to the least, as
+// they were when each block was a linked list. Things linked into the
+// block by func aren't visited, and things unlinked from it are skipped.
 //
 boolean P_BlockThingsIterator(int x, int y, boolean (*func)(mobj_t *))
 {
+    boolean     result = true;
+
     if (!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
     {
-        mobj_t  *mobj;
+        blockthings_t   *block = &blockthings[y * bmapwidth + x];
+        int             i = block->count;
 
-        for (mobj = blocklinks[y * bmapwidth + x]; mobj; mobj = mobj->bnext)
-            if (!func(mobj))
-                return false;
+        blockthingsiterators++;
+        while (i--)
+        {
+            mobj_t      *mobj = block->mobj[i];
+
+            if (mobj && !func(mobj))
+            {
+                result = false;
+                break;
+            }
+        }
+        blockthingsiterators--;
     }
-    return true;
+    return result;
+}
+
+#define BLOCKTHINGSCHUNK        64
+
+//
+// P_BlockThingsNearIterator
+// As P_BlockThingsIterator, but only calls func for things whose
+// bounding box comes within range of (tx, ty). The positions and radii
+// are tested straight from the block's arrays, a chunk at a time, so
+// things that are out of range are never dereferenced.
+//
+boolean P_BlockThingsNearIterator(int x, int y, fixed_t tx, fixed_t ty, fixed_t range,
+                                  boolean (*func)(mobj_t *))
+{
+    boolean     result = true;
+
+    if (!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
+    {
+        blockthings_t   *block = &blockthings[y * bmapwidth + x];
+        int             top = block->count;
+
+        blockthingsiterators++;
+        while (top > 0 && result)
+        {
+            int         bottom = MAX(0, top - BLOCKTHINGSCHUNK);
+            byte        hit[BLOCKTHINGSCHUNK];
+            int         i;
+
+            // func may grow the block's arrays, so fetch them for each chunk
+            for (i = bottom; i < top; i++)
+            {
+                fixed_t dist = block->radius[i] + range;
+                fixed_t dx = block->x[i] - tx;
+                fixed_t dy = block->y[i] - ty;
+
+                dx = (dx ^ (dx >> 31)) - (dx >> 31);
+                dy = (dy ^ (dy >> 31)) - (dy >> 31);
+                hit[i - bottom] = ((dx < dist) & (dy < dist));
+            }
+
+            for (i = top - 1; i >= bottom; i--)
+                if (hit[i - bottom])
+                {
+                    mobj_t      *mobj = block->mobj[i];
+
+                    if (mobj && !func(mobj))
+                    {
+                        result = false;
+                        break;
+                    }
+                }
+
+            top = bottom;
+        }
+        blockthingsiterators--;
+    }
+    return result;
 }
 
 //
@@ -396,7 +644,7 @@ static void check_intercept(void)
 divline_t       trace;
 
 //
-// PIT_AddLineIntercepts.
+// P_AddLineIntercepts
 // Looks for lines in the given block
 // that intercept the given trace
 // to add to the intercepts list.
@@ -404,44 +652,61 @@ divline_t       trace;
 // A line is crossed if its endpoints
 // are on opposite sides of the trace.
 //
-boolean PIT_AddLineIntercepts(line_t *ld)
+static void P_AddLineIntercepts(int x, int y)
 {
-    int         s1;
-    int         s2;
-    fixed_t     frac;
-    divline_t   dl;
-
-    // avoid precision problems with two routines
-    if (trace.dx > FRACUNIT * 16 || trace.dy > FRACUNIT * 16
-        || trace.dx < -FRACUNIT * 16 || trace.dy < -FRACUNIT * 16)
-    {
-        s1 = P_PointOnDivlineSide(ld->v1->x, ld->v1->y, &trace);
-        s2 = P_PointOnDivlineSide(ld->v2->x, ld->v2->y, &trace);
-    }
-    else
+    if (!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
     {
-        s1 = P_PointOnLineSide(trace.x, trace.y, ld);
-        s2 = P_PointOnLineSide(trace.x + trace.dx, trace.y + trace.dy, ld);
-    }
+        int                     block = y * bmapwidth + x;
+        const blockline_t       *bl = &blocklines[blocklinesindex[block]];
+        const blockline_t       *end = &blocklines[blocklinesindex[block + 1]];
 
-    if (s1 == s2)
-        return true;    // line isn't crossed
+        for (; bl < end; bl++)
+        {
+            int         linenum = bl->linenum;
+            int         s1;
+            int         s2;
+            fixed_t     frac;
+            divline_t   dl;
 
-    // hit the line
-    P_MakeDivline(ld, &dl);
-    frac = P_InterceptVector(&trace, &dl);
+            if (linevalidcount[linenum] == validcount)
+                continue;       // line has already been checked
 
-    if (frac < 0)
-        return true;    // behind source
+            linevalidcount[linenum] = validcount;
 
-    check_intercept();  // killough
+            // avoid precision problems with two routines
+            if (trace.dx > FRACUNIT * 16 || trace.dy > FRACUNIT * 16
+                || trace.dx < -FRACUNIT * 16 || trace.dy < -FRACUNIT * 16)
+            {
+                s1 = P_PointOnDivlineSide(bl->x1, bl->y1, &trace);
+                s2 = P_PointOnDivlineSide(bl->x2, bl->y2, &trace);
+            }
+            else
+            {
+                s1 = P_PointOnBlockLineSide(trace.x, trace.y, bl);
+                s2 = P_PointOnBlockLineSide(trace.x + trace.dx, trace.y + trace.dy, bl);
+            }
 
-    intercept_p->frac = frac;
-    intercept_p->isaline = true;
-    intercept_p->d.line = ld;
-    intercept_p++;
+            if (s1 == s2)
+                continue;       // line isn't crossed
+
+            // hit the line
+            dl.x = bl->x1;
+            dl.y = bl->y1;
+            dl.dx = bl->dx;
+            dl.dy = bl->dy;
+            frac = P_InterceptVector(&trace, &dl);
+
+            if (frac < 0)
+                continue;       // behind source
 
-    return true;        // continue
+            check_intercept();  // killough
+
+            intercept_p->frac = frac;
+            intercept_p->isaline = true;
+            intercept_p->d.line = &lines[linenum];
+            intercept_p++;
+        }
+    }
 }
 
 //
@@ -633,8 +898,7 @@ boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
     for (count = 0; count < 64; count++)
     {
         if (flags & PT_ADDLINES)
-            if (!P_BlockLinesIterator(mapx, mapy, PIT_AddLineIntercepts))
-                return false;           // early out
+            P_AddLineIntercepts(mapx, mapy);
 
         if (flags & PT_ADDTHINGS)
             if (!P_BlockThingsIterator(mapx, mapy, PIT_AddThingIntercepts))
@@ -50,7 +50,7 @@
 #include "z_zone.h"
 
 void G_PlayerReborn(int player);
-void P_DelSeclist(msecnode_t *node);
+void P_DelSeclist(int node);
 void P_SpawnShadow(mobj_t *actor);
 
 int                     bloodsplats = BLOODSPLATS_DEFAULT;
@@ -64,7 +64,7 @@ boolean                 footclip = FOOTCLIP_DEFAULT;
 boolean                 shadows = SHADOWS_DEFAULT;
 int                     smoketrails = SMOKETRAILS_DEFAULT;
 
-extern msecnode_t       *sector_list;   // phares 3/16/98
+extern int             sector_list;    // phares 3/16/98
 extern boolean          *isliquid;
 
 //
@@ -700,7 +700,7 @@ void P_RemoveMobj(mobj_t *mobj)
     if (sector_list)
     {
         P_DelSeclist(sector_list);
-        sector_list = NULL;
+        sector_list = 0;
     }
     
     mobj->flags |= (MF_NOSECTOR | MF_NOBLOCKMAP);
@@ -1247,6 +1247,7 @@ void P_CheckMissileSpawn(mobj_t *th)
     th->x += (th->momx >> 1);
     th->y += (th->momy >> 1);
     th->z += (th->momz >> 1);
+    P_UpdateThingBlockPosition(th);
 
     if (!P_TryMove(th, th->x, th->y, false))
         P_ExplodeMissile(th);
@@ -82,7 +82,7 @@
 // The sound code uses the x,y, and subsector fields
 // to do stereo positioning of any sound effited by the mobj_t.
 //
-// The play simulation uses the blocklinks, x,y,z, radius, height
+// The play simulation uses the blockthings, x,y,z, radius, height
 // to determine when mobj_ts are touching each other,
 // touching lines in the map, or hit by trace lines (gunshots,
 // lines of sight, etc).
@@ -303,8 +303,7 @@ typedef struct mobj_s
 
     // Interaction info, by BLOCKMAP.
     // Links in blocks (if needed).
-    struct mobj_s       *bnext;
-    struct mobj_s       **bprev;        // killough 8/11/98: change to ptr-to-ptr
+    int                 blocknum;       // mapblock linked into, or -1
 
     struct subsector_s  *subsector;
 
@@ -376,7 +375,7 @@ typedef struct mobj_s
     void                (*colfunc)(void);
 
     // a linked list of sectors where this object appears
-    struct msecnode_s   *touching_sectorlist;   // phares 3/14/98
+    int                 touching_sectorlist;    // phares 3/14/98
 
     short               gear;           // killough 11/98: used in torque simulation
 
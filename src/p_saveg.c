@@ -40,18 +40,54 @@
 #include "doomstat.h"
 #include "dstrings.h"
 #include "i_system.h"
+#include "m_compress.h"
 #include "m_misc.h"
+#include "m_random.h"
 #include "p_local.h"
 #include "p_saveg.h"
+#include "s_sound.h"
+#include "SDL.h"
 #include "version.h"
 #include "z_zone.h"
 
 #define SAVEGAME_EOF    0x1d
 
-FILE            *save_stream;
 int             savegamelength;
 boolean         savegame_error;
 
+// The savegame is built up in, or read from, this buffer, so that the
+// file is written or read in one go.
+static byte     *savebuffer;
+static size_t   savebuffersize;
+static byte     *save_p;
+static byte     *save_end;
+
+//
+// Savegame sections
+// After the header, which is always stored as is so that the menu can read
+// it, each section of the savegame is stored as a record of its own: a tag,
+// a version, how it is stored, its length and its stored length, followed
+// by the (usually compressed) section itself.
+//
+#define SAVEGAME_STORED         0
+#define SAVEGAME_COMPRESSED     1
+#define SECTIONHEADERSIZE       15
+
+enum
+{
+    SECTION_PLAYERS,
+    SECTION_WORLD,
+    SECTION_THINKERS,
+    SECTION_SPECIALS,
+    NUMSECTIONS
+};
+
+static char     *sectiontags[NUMSECTIONS] = { "PLYR", "WRLD", "THNK", "SPEC" };
+static int      sectionversions[NUMSECTIONS] = { 1, 2, 1, 1 };
+
+// where each section starts in the buffer, and where the last one ends
+static size_t   savesection[NUMSECTIONS + 1];
+
 extern boolean  *isliquid;
 extern boolean  footclip;
 
@@ -89,65 +125,524 @@ char *P_SaveGameFile(int slot)
     return filename;
 }
 
+static void P_FinishSaveGame(void);
+
+//
+// P_OpenSaveGame
+// Read a whole savegame file into the buffer, ready to be unarchived.
+//
+boolean P_OpenSaveGame(char *filename)
+{
+    FILE        *handle;
+    long        length;
+
+    P_FinishSaveGame();
+
+    if (!(handle = fopen(filename, "rb")))
+        return false;
+
+    fseek(handle, 0, SEEK_END);
+    length = ftell(handle);
+    fseek(handle, 0, SEEK_SET);
+
+    if (length < 0)
+    {
+        fclose(handle);
+        return false;
+    }
+
+    if ((size_t)length > savebuffersize)
+    {
+        savebuffersize = length;
+        savebuffer = realloc(savebuffer, savebuffersize);
+    }
+
+    length = fread(savebuffer, 1, length, handle);
+    fclose(handle);
+
+    save_p = savebuffer;
+    save_end = savebuffer + length;
+    savegame_error = false;
+
+    return true;
+}
+
+//
+// P_CreateSaveGame
+// Start archiving into an empty buffer.
+//
+void P_CreateSaveGame(void)
+{
+    if (!savebuffer)
+    {
+        savebuffersize = 0x10000;
+        savebuffer = malloc(savebuffersize);
+    }
+
+    save_p = savebuffer;
+    save_end = savebuffer + savebuffersize;
+    savegame_error = false;
+}
+
+//
+// Writing savegames
+// Once a savegame has been archived into the buffer, the buffer is handed
+// to a thread of its own to be compressed and written to a temporary
+// file, which is then renamed to the real file. The game carries on while
+// that happens, and gets the previous save's buffer back to archive the
+// next one into. Whether it was written is found out with
+// P_SaveGameStatus() once it's done.
+//
+typedef struct
+{
+    byte        *buffer;
+    size_t      buffersize;
+    size_t      sections[NUMSECTIONS + 1];
+    byte        *output;
+    size_t      outputsize;
+    char        *tempfile;
+    char        *filename;
+    boolean     done;
+    boolean     failed;
+} savejob_t;
+
+static savejob_t        savejob;
+static SDL_Thread       *savethread;
+static SDL_mutex        *savemutex;
+static boolean          savepending;
+static savestatus_t     savestatus;             // not reported yet
+
+static void P_FinishSnapshot(boolean written);
+
+static void WriteLong(byte *p, int value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+}
+
+static int ReadLong(byte *p)
+{
+    return (p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24));
+}
+
+// Lay out the job's buffer as it is stored in the file, compressing each
+// section as it goes, and return its length.
+static size_t P_CompressSaveGame(savejob_t *job)
+{
+    size_t      size = job->sections[0] + 1;
+    byte        *op;
+    int         i;
+
+    for (i = 0; i < NUMSECTIONS; i++)
+        size += SECTIONHEADERSIZE + M_CompressBound(job->sections[i + 1] - job->sections[i]);
+
+    if (size > job->outputsize)
+    {
+        job->outputsize = size;
+        job->output = realloc(job->output, job->outputsize);
+    }
+
+    memcpy(job->output, job->buffer, job->sections[0]);
+    op = job->output + job->sections[0];
+
+    for (i = 0; i < NUMSECTIONS; i++)
+    {
+        byte    *section = job->buffer + job->sections[i];
+        int     length = job->sections[i + 1] - job->sections[i];
+        byte    *header = op;
+        int     stored;
+
+        op += SECTIONHEADERSIZE;
+        stored = M_Compress(section, length, op);
+
+        // keep the section as it is if it didn't get any smaller
+        if (stored >= length)
+        {
+            memcpy(op, section, length);
+            stored = length;
+            header[6] = SAVEGAME_STORED;
+        }
+        else
+            header[6] = SAVEGAME_COMPRESSED;
+
+        memcpy(header, sectiontags[i], 4);
+        header[4] = sectionversions[i] & 0xff;
+        header[5] = (sectionversions[i] >> 8) & 0xff;
+        WriteLong(header + 7, length);
+        WriteLong(header + 11, stored);
+        op += stored;
+    }
+
+    *op++ = SAVEGAME_EOF;
+
+    return (op - job->output);
+}
+
+static int P_WriteSaveGameJob(void *arg)
+{
+    savejob_t   *job = (savejob_t *)arg;
+    size_t      length = P_CompressSaveGame(job);
+    FILE        *handle = fopen(job->tempfile, "wb");
+    boolean     error = false;
+
+    if (!handle)
+        error = true;
+    else
+    {
+        if (fwrite(job->output, 1, length, handle) < length)
+            error = true;
+
+        if (fclose(handle))
+            error = true;
+
+        // only replace the old savegame if the new one was written
+        if (error || !M_RenameFile(job->tempfile, job->filename))
+        {
+            remove(job->tempfile);
+            error = true;
+        }
+    }
+
+    SDL_LockMutex(savemutex);
+    job->failed = error;
+    job->done = true;
+    SDL_UnlockMutex(savemutex);
+
+    return 0;
+}
+
+// Collect the result of the savegame being written, if any, keeping it
+// until it's reported.
+static void P_FinishSaveGame(void)
+{
+    if (!savepending)
+        return;
+
+    if (savethread)
+    {
+        SDL_WaitThread(savethread, NULL);
+        savethread = NULL;
+    }
+    savepending = false;
+
+    savestatus = (savejob.failed ? SAVE_FAILED : SAVE_WRITTEN);
+    P_FinishSnapshot(!savejob.failed);
+}
+
+static savestatus_t P_ReportSaveGame(void)
+{
+    savestatus_t        status = savestatus;
+
+    savestatus = SAVE_NONE;
+    return status;
+}
+
+//
+// P_SaveGameStatus
+// Returns whether the last savegame has been written yet. Once it has,
+// SAVE_WRITTEN or SAVE_FAILED is only returned the once.
+//
+savestatus_t P_SaveGameStatus(void)
+{
+    if (savepending)
+    {
+        boolean done;
+
+        SDL_LockMutex(savemutex);
+        done = savejob.done;
+        SDL_UnlockMutex(savemutex);
+
+        if (!done)
+            return SAVE_WRITING;
+
+        P_FinishSaveGame();
+    }
+
+    return P_ReportSaveGame();
+}
+
+//
+// P_WaitForSaveGame
+// Wait for the savegame being written, if any, to be finished, and return
+// whether it was written.
+//
+savestatus_t P_WaitForSaveGame(void)
+{
+    P_FinishSaveGame();
+    return P_ReportSaveGame();
+}
+
+//
+// P_WriteSaveGameFile
+// Write everything archived since P_CreateSaveGame() to tempfile, and
+// then rename it to filename, in the background.
+//
+void P_WriteSaveGameFile(char *tempfile, char *filename)
+{
+    byte        *buffer;
+    size_t      buffersize;
+
+    P_FinishSaveGame();
+
+    if (!savemutex)
+        savemutex = SDL_CreateMutex();
+
+    buffer = savejob.buffer;
+    buffersize = savejob.buffersize;
+
+    free(savejob.tempfile);
+    free(savejob.filename);
+    savejob.tempfile = strdup(tempfile);
+    savejob.filename = strdup(filename);
+    memcpy(savejob.sections, savesection, sizeof(savesection));
+    savejob.done = false;
+    savejob.failed = false;
+    savepending = true;
+
+    // swap buffers with the last save
+    savejob.buffer = savebuffer;
+    savejob.buffersize = savebuffersize;
+    savebuffer = buffer;
+    savebuffersize = buffersize;
+
+#ifdef SDL20
+    savethread = SDL_CreateThread(P_WriteSaveGameJob, "savegame", &savejob);
+#else
+    savethread = SDL_CreateThread(P_WriteSaveGameJob, &savejob);
+#endif
+
+    if (!savethread)
+        P_WriteSaveGameJob(&savejob);
+}
+
+//
+// Reading savegames
+// Once the header has been read, the sections that follow it are found and
+// decompressed, each on a thread of its own, back into one buffer laid out
+// just as it was archived, so the rest of the savegame can be read from it.
+//
+typedef struct
+{
+    byte        *src;
+    int         srclen;
+    byte        *dest;
+    int         destlen;
+    boolean     compressed;
+    boolean     error;
+} section_t;
+
+static int P_ExpandSection(void *arg)
+{
+    section_t   *section = (section_t *)arg;
+
+    if (!section->compressed)
+        memcpy(section->dest, section->src, section->destlen);
+    else if (!M_Decompress(section->src, section->srclen, section->dest, section->destlen))
+        section->error = true;
+
+    return 0;
+}
+
+static boolean P_ExpandSaveGame(void)
+{
+    section_t   sections[NUMSECTIONS];
+    SDL_Thread  *threads[NUMSECTIONS];
+    size_t      headersize = save_p - savebuffer;
+    size_t      size = headersize + 1;
+    byte        *buffer;
+    byte        *dest;
+    boolean     error = false;
+    int         i;
+
+    memset(sections, 0, sizeof(sections));
+
+    while (save_p < save_end && *save_p != SAVEGAME_EOF)
+    {
+        int     version;
+        int     method;
+        int     length;
+        int     stored;
+
+        if (save_end - save_p < SECTIONHEADERSIZE)
+            return false;
+
+        version = save_p[4] | (save_p[5] << 8);
+        method = save_p[6];
+        length = ReadLong(save_p + 7);
+        stored = ReadLong(save_p + 11);
+
+        if (length < 0 || stored < 0 || stored > save_end - save_p - SECTIONHEADERSIZE)
+            return false;
+
+        // skip any sections that aren't known about
+        for (i = 0; i < NUMSECTIONS; i++)
+            if (!memcmp(save_p, sectiontags[i], 4))
+            {
+                if (version != sectionversions[i] || sections[i].src
+                    || (method != SAVEGAME_STORED && method != SAVEGAME_COMPRESSED)
+                    || (method == SAVEGAME_STORED && stored != length))
+                    return false;
+
+                sections[i].src = save_p + SECTIONHEADERSIZE;
+                sections[i].srclen = stored;
+                sections[i].destlen = length;
+                sections[i].compressed = (method == SAVEGAME_COMPRESSED);
+                size += length;
+                break;
+            }
+
+        save_p += SECTIONHEADERSIZE + stored;
+    }
+
+    if (save_p >= save_end)
+        return false;
+
+    for (i = 0; i < NUMSECTIONS; i++)
+        if (!sections[i].src)
+            return false;
+
+    if (!(buffer = malloc(size)))
+        return false;
+
+    memcpy(buffer, savebuffer, headersize);
+    dest = buffer + headersize;
+
+    for (i = 0; i < NUMSECTIONS; i++)
+    {
+        sections[i].dest = dest;
+        dest += sections[i].destlen;
+
+#ifdef SDL20
+        threads[i] = SDL_CreateThread(P_ExpandSection, "savegame", &sections[i]);
+#else
+        threads[i] = SDL_CreateThread(P_ExpandSection, &sections[i]);
+#endif
+
+        if (!threads[i])
+            P_ExpandSection(&sections[i]);
+    }
+
+    *dest = SAVEGAME_EOF;
+
+    for (i = 0; i < NUMSECTIONS; i++)
+    {
+        if (threads[i])
+            SDL_WaitThread(threads[i], NULL);
+        if (sections[i].error)
+            error = true;
+    }
+
+    if (error)
+    {
+        free(buffer);
+        return false;
+    }
+
+    free(savebuffer);
+    savebuffer = buffer;
+    savebuffersize = size;
+    save_p = savebuffer + headersize;
+    save_end = savebuffer + savebuffersize;
+
+    return true;
+}
+
+// Make room in the buffer for at least size more bytes
+static void saveg_grow(size_t size)
+{
+    size_t      position = save_p - savebuffer;
+
+    while (position + size > savebuffersize)
+        savebuffersize *= 2;
+
+    savebuffer = realloc(savebuffer, savebuffersize);
+    save_p = savebuffer + position;
+    save_end = savebuffer + savebuffersize;
+}
+
 // Endian-safe integer read/write functions
 static byte saveg_read8(void)
 {
-    byte        result;
-
-    if (fread(&result, 1, 1, save_stream) < 1)
+    if (save_p >= save_end)
+    {
         savegame_error = true;
+        return 0;
+    }
 
-    return result;
+    return *save_p++;
 }
 
 static void saveg_write8(byte value)
 {
-    if (fwrite(&value, 1, 1, save_stream) < 1)
-        savegame_error = true;
+    if (save_p >= save_end)
+        saveg_grow(1);
+
+    *save_p++ = value;
 }
 
 static short saveg_read16(void)
 {
     int result;
 
-    result = saveg_read8();
-    result |= saveg_read8() << 8;
+    if (save_end - save_p < 2)
+    {
+        save_p = save_end;
+        savegame_error = true;
+        return 0;
+    }
+
+    result = save_p[0] | (save_p[1] << 8);
+    save_p += 2;
 
     return result;
 }
 
 static void saveg_write16(short value)
 {
-    saveg_write8(value & 0xff);
-    saveg_write8((value >> 8) & 0xff);
+    if (save_end - save_p < 2)
+        saveg_grow(2);
+
+    save_p[0] = value & 0xff;
+    save_p[1] = (value >> 8) & 0xff;
+    save_p += 2;
 }
 
 static int saveg_read32(void)
 {
     int result;
 
-    result = saveg_read8();
-    result |= saveg_read8() << 8;
-    result |= saveg_read8() << 16;
-    result |= saveg_read8() << 24;
+    if (save_end - save_p < 4)
+    {
+        save_p = save_end;
+        savegame_error = true;
+        return 0;
+    }
+
+    result = save_p[0] | (save_p[1] << 8) | (save_p[2] << 16) | (save_p[3] << 24);
+    save_p += 4;
 
     return result;
 }
 
 static void saveg_write32(int value)
 {
-    saveg_write8(value & 0xff);
-    saveg_write8((value >> 8) & 0xff);
-    saveg_write8((value >> 16) & 0xff);
-    saveg_write8((value >> 24) & 0xff);
+    if (save_end - save_p < 4)
+        saveg_grow(4);
+
+    save_p[0] = value & 0xff;
+    save_p[1] = (value >> 8) & 0xff;
+    save_p[2] = (value >> 16) & 0xff;
+    save_p[3] = (value >> 24) & 0xff;
+    save_p += 4;
 }
 
 // Pad to 4-byte boundaries
 static void saveg_read_pad(void)
 {
-    unsigned long       pos = ftell(save_stream);
-    int                 padding = (4 - (pos & 3)) & 3;
-    int                 i;
+    int padding = (4 - ((save_p - savebuffer) & 3)) & 3;
+    int i;
 
     for (i = 0; i < padding; ++i)
         saveg_read8();
@@ -155,9 +650,8 @@ static void saveg_read_pad(void)
 
 static void saveg_write_pad(void)
 {
-    unsigned long       pos = ftell(save_stream);
-    int                 padding = (4 - (pos & 3)) & 3;
-    int                 i;
+    int padding = (4 - ((save_p - savebuffer) & 3)) & 3;
+    int i;
 
     for (i = 0; i < padding; ++i)
         saveg_write8(0);
@@ -305,11 +799,11 @@ static void saveg_read_mobj_t(mobj_t *str)
     // int frame
     str->frame = saveg_read32();
 
-    // struct mobj_s *bnext
-    str->bnext = (mobj_t *)saveg_readp();
+    // int blocknum
+    str->blocknum = saveg_read32();
 
-    // struct mobj_s **bprev
-    str->bprev = (mobj_t **)saveg_readp();
+    // unused (was struct mobj_s **bprev)
+    saveg_read32();
 
     // struct subsector_s *subsector
     str->subsector = (subsector_t *)saveg_readp();
@@ -404,8 +898,8 @@ static void saveg_read_mobj_t(mobj_t *str)
     // int floatbob
     str->floatbob = saveg_read32();
 
-    // struct msecnode_s *touching_sectorlist
-    str->touching_sectorlist = NULL;
+    // int touching_sectorlist
+    str->touching_sectorlist = 0;
 
     // short gear
     str->gear = saveg_read16();
@@ -446,11 +940,11 @@ static void saveg_write_mobj_t(mobj_t *str)
     // int frame
     saveg_write32(str->frame);
 
-    // struct mobj_s *bnext
-    saveg_writep(str->bnext);
+    // int blocknum
+    saveg_write32(str->blocknum);
 
-    // struct mobj_s *bprev
-    saveg_writep(str->bprev);
+    // unused (was struct mobj_s **bprev)
+    saveg_write32(0);
 
     // struct subsector_s *subsector
     saveg_writep(str->subsector);
@@ -1468,7 +1962,7 @@ boolean P_ReadSaveGameHeader(char *description)
     c = saveg_read8();
     leveltime = (a << 16) + (b << 8) + c;
 
-    return true;
+    return P_ExpandSaveGame();
 }
 
 //
@@ -1484,6 +1978,7 @@ boolean P_ReadSaveGameEOF(void)
 //
 void P_WriteSaveGameEOF(void)
 {
+    savesection[NUMSECTIONS] = save_p - savebuffer;
     saveg_write8(SAVEGAME_EOF);
 }
 
@@ -1494,6 +1989,8 @@ void P_ArchivePlayers(void)
 {
     int i;
 
+    savesection[SECTION_PLAYERS] = save_p - savebuffer;
+
     for (i = 0; i < MAXPLAYERS; i++)
     {
         if (!playeringame[i])
@@ -1530,20 +2027,184 @@ void P_UnArchivePlayers(void)
     }
 }
 
+//
+// World state
+// The state of every sector, line and side is remembered once the level
+// has been set up, and only those that have changed since are archived,
+// each after a bitmap of which ones they are. The rest are put back as they
+// were when the level started when the savegame is unarchived.
+//
+typedef struct
+{
+    fixed_t     floorheight;
+    fixed_t     ceilingheight;
+    short       floorpic;
+    short       ceilingpic;
+    short       lightlevel;
+    short       special;
+    short       tag;
+} sectorstate_t;
+
+typedef struct
+{
+    unsigned short      flags;
+    short               special;
+    short               tag;
+} linestate_t;
+
+typedef struct
+{
+    fixed_t     textureoffset;
+    fixed_t     rowoffset;
+    short       toptexture;
+    short       bottomtexture;
+    short       midtexture;
+} sidestate_t;
+
+static sectorstate_t    *sectorstates;
+static linestate_t      *linestates;
+static sidestate_t      *sidestates;
+
+//
+// P_SnapshotWorld
+// Remember the state of the world as the level starts.
+//
+void P_SnapshotWorld(void)
+{
+    int i;
+
+    sectorstates = Z_Malloc(numsectors * sizeof(sectorstate_t), PU_LEVEL, NULL);
+    for (i = 0; i < numsectors; i++)
+    {
+        sector_t        *sec = &sectors[i];
+        sectorstate_t   *state = &sectorstates[i];
+
+        state->floorheight = sec->floorheight;
+        state->ceilingheight = sec->ceilingheight;
+        state->floorpic = sec->floorpic;
+        state->ceilingpic = sec->ceilingpic;
+        state->lightlevel = sec->lightlevel;
+        state->special = sec->special;
+        state->tag = sec->tag;
+    }
+
+    linestates = Z_Malloc(numlines * sizeof(linestate_t), PU_LEVEL, NULL);
+    for (i = 0; i < numlines; i++)
+    {
+        line_t          *li = &lines[i];
+        linestate_t     *state = &linestates[i];
+
+        state->flags = li->flags;
+        state->special = li->special;
+        state->tag = li->tag;
+    }
+
+    sidestates = Z_Malloc(numsides * sizeof(sidestate_t), PU_LEVEL, NULL);
+    for (i = 0; i < numsides; i++)
+    {
+        side_t          *si = &sides[i];
+        sidestate_t     *state = &sidestates[i];
+
+        state->textureoffset = si->textureoffset;
+        state->rowoffset = si->rowoffset;
+        state->toptexture = si->toptexture;
+        state->bottomtexture = si->bottomtexture;
+        state->midtexture = si->midtexture;
+    }
+}
+
+static boolean P_SectorChanged(int i)
+{
+    sector_t            *sec = &sectors[i];
+    sectorstate_t       *state = &sectorstates[i];
+
+    return (sec->floorheight != state->floorheight
+            || sec->ceilingheight != state->ceilingheight
+            || sec->floorpic != state->floorpic
+            || sec->ceilingpic != state->ceilingpic
+            || sec->lightlevel != state->lightlevel
+            || sec->special != state->special
+            || sec->tag != state->tag);
+}
+
+static boolean P_LineChanged(int i)
+{
+    line_t              *li = &lines[i];
+    linestate_t         *state = &linestates[i];
+
+    return (li->flags != state->flags
+            || li->special != state->special
+            || li->tag != state->tag);
+}
+
+static boolean P_SideChanged(int i)
+{
+    side_t              *si = &sides[i];
+    sidestate_t         *state = &sidestates[i];
+
+    return (si->textureoffset != state->textureoffset
+            || si->rowoffset != state->rowoffset
+            || si->toptexture != state->toptexture
+            || si->bottomtexture != state->bottomtexture
+            || si->midtexture != state->midtexture);
+}
+
+// Write a bitmap of which of count elements have changed
+static void saveg_write_changed(int count, boolean (*changed)(int))
+{
+    int i;
+
+    for (i = 0; i < count; i += 8)
+    {
+        byte    bits = 0;
+        int     j;
+
+        for (j = 0; j < 8 && i + j < count; j++)
+            if (changed(i + j))
+                bits |= (1 << j);
+
+        saveg_write8(bits);
+    }
+}
+
+// Read a bitmap of which of count elements have changed
+static byte *saveg_read_changed(int count)
+{
+    byte        *bitmap = save_p;
+    int         size = (count + 7) / 8;
+
+    if (save_end - save_p < size)
+    {
+        savegame_error = true;
+        save_p = save_end;
+        return NULL;
+    }
+
+    save_p += size;
+
+    return bitmap;
+}
+
+#define CHANGED(bitmap, i)      ((bitmap)[(i) >> 3] & (1 << ((i) & 7)))
+
 //
 // P_ArchiveWorld
 //
 void P_ArchiveWorld(void)
 {
     int         i;
-    int         j;
-    sector_t    *sec;
-    line_t      *li;
-    side_t      *si;
+
+    savesection[SECTION_WORLD] = save_p - savebuffer;
 
     // do sectors
-    for (i = 0, sec = sectors; i < numsectors; i++, sec++)
+    saveg_write_changed(numsectors, P_SectorChanged);
+    for (i = 0; i < numsectors; i++)
     {
+        sector_t        *sec = &sectors[i];
+
+        if (!P_SectorChanged(i))
+            continue;
+
         saveg_write16(sec->floorheight >> FRACBITS);
         saveg_write16(sec->ceilingheight >> FRACBITS);
         saveg_write16(sec->floorpic);
@@ -1554,24 +2215,33 @@ void P_ArchiveWorld(void)
     }
 
     // do lines
-    for (i = 0, li = lines; i < numlines; i++, li++)
+    saveg_write_changed(numlines, P_LineChanged);
+    for (i = 0; i < numlines; i++)
     {
+        line_t          *li = &lines[i];
+
+        if (!P_LineChanged(i))
+            continue;
+
         saveg_write16(li->flags);
         saveg_write16(li->special);
         saveg_write16(li->tag);
-        for (j = 0; j < 2; j++)
-        {
-            if (li->sidenum[j] == NO_INDEX)
-                continue;
+    }
 
-            si = &sides[li->sidenum[j]];
+    // do sides
+    saveg_write_changed(numsides, P_SideChanged);
+    for (i = 0; i < numsides; i++)
+    {
+        side_t          *si = &sides[i];
 
-            saveg_write16(si->textureoffset >> FRACBITS);
-            saveg_write16(si->rowoffset >> FRACBITS);
-            saveg_write16(si->toptexture);
-            saveg_write16(si->bottomtexture);
-            saveg_write16(si->midtexture);
-        }
+        if (!P_SideChanged(i))
+            continue;
+
+        saveg_write16(si->textureoffset >> FRACBITS);
+        saveg_write16(si->rowoffset >> FRACBITS);
+        saveg_write16(si->toptexture);
+        saveg_write16(si->bottomtexture);
+        saveg_write16(si->midtexture);
     }
 }
 
@@ -1581,14 +2251,36 @@ void P_ArchiveWorld(void)
 void P_UnArchiveWorld(void)
 {
     int         i;
-    int         j;
-    sector_t    *sec;
-    line_t      *li;
-    side_t      *si;
+    byte        *bitmap;
 
     // do sectors
-    for (i = 0, sec = sectors; i < numsectors; i++, sec++)
+    for (i = 0; i < numsectors; i++)
     {
+        sectors[i].specialdata = 0;
+        sectors[i].soundtarget = 0;
+    }
+
+    if (!(bitmap = saveg_read_changed(numsectors)))
+        return;
+
+    for (i = 0; i < numsectors; i++)
+    {
+        sector_t        *sec = &sectors[i];
+
+        if (!CHANGED(bitmap, i))
+        {
+            sectorstate_t       *state = &sectorstates[i];
+
+            sec->floorheight = state->floorheight;
+            sec->ceilingheight = state->ceilingheight;
+            sec->floorpic = state->floorpic;
+            sec->ceilingpic = state->ceilingpic;
+            sec->lightlevel = state->lightlevel;
+            sec->special = state->special;
+            sec->tag = state->tag;
+            continue;
+        }
+
         sec->floorheight = saveg_read16() << FRACBITS;
         sec->ceilingheight = saveg_read16() << FRACBITS;
         sec->floorpic = saveg_read16();
@@ -1596,29 +2288,56 @@ void P_UnArchiveWorld(void)
         sec->lightlevel = saveg_read16();
         sec->special = saveg_read16();
         sec->tag = saveg_read16();
-        sec->specialdata = 0;
-        sec->soundtarget = 0;
     }
 
     // do lines
-    for (i = 0, li = lines; i < numlines; i++, li++)
+    if (!(bitmap = saveg_read_changed(numlines)))
+        return;
+
+    for (i = 0; i < numlines; i++)
     {
+        line_t          *li = &lines[i];
+
+        if (!CHANGED(bitmap, i))
+        {
+            linestate_t         *state = &linestates[i];
+
+            li->flags = state->flags;
+            li->special = state->special;
+            li->tag = state->tag;
+            continue;
+        }
+
         li->flags = saveg_read16();
         li->special = saveg_read16();
         li->tag = saveg_read16();
-        for (j = 0; j < 2; j++)
-        {
-            if (li->sidenum[j] == NO_INDEX)
-                continue;
+    }
 
-            si = &sides[li->sidenum[j]];
+    // do sides
+    if (!(bitmap = saveg_read_changed(numsides)))
+        return;
 
-            si->textureoffset = saveg_read16() << FRACBITS;
-            si->rowoffset = saveg_read16() << FRACBITS;
-            si->toptexture = saveg_read16();
-            si->bottomtexture = saveg_read16();
-            si->midtexture = saveg_read16();
+    for (i = 0; i < numsides; i++)
+    {
+        side_t          *si = &sides[i];
+
+        if (!CHANGED(bitmap, i))
+        {
+            sidestate_t         *state = &sidestates[i];
+
+            si->textureoffset = state->textureoffset;
+            si->rowoffset = state->rowoffset;
+            si->toptexture = state->toptexture;
+            si->bottomtexture = state->bottomtexture;
+            si->midtexture = state->midtexture;
+            continue;
         }
+
+        si->textureoffset = saveg_read16() << FRACBITS;
+        si->rowoffset = saveg_read16() << FRACBITS;
+        si->toptexture = saveg_read16();
+        si->bottomtexture = saveg_read16();
+        si->midtexture = saveg_read16();
     }
 }
 
@@ -1638,6 +2357,8 @@ void P_ArchiveThinkers(void)
 {
     thinker_t   *th;
 
+    savesection[SECTION_THINKERS] = save_p - savebuffer;
+
     // save off the current thinkers
     for (th = thinkercap.next; th != &thinkercap; th = th->next)
     {
@@ -1807,6 +2528,8 @@ void P_ArchiveSpecials(void)
     plat_t      *plat;
     ceiling_t   *ceiling;
 
+    savesection[SECTION_SPECIALS] = save_p - savebuffer;
+
     // save off the current thinkers
     for (th = thinkercap.next; th != &thinkercap; th = th->next)
     {
@@ -2026,3 +2749,144 @@ void P_UnArchiveSpecials(void)
         }
     }
 }
+
+//
+// Snapshots
+// Each savegame's sections are also copied into one of a number of buffers
+// in memory, and the playsim can be restored from one without setting up
+// the level again, as long as the same level is still being played.
+//
+typedef struct
+{
+    byte        *buffer;
+    size_t      buffersize;
+    size_t      start;                  // where the players section starts
+    size_t      length;
+    boolean     valid;
+    char        description[SAVESTRINGSIZE];
+    skill_t     skill;
+    int         episode;
+    int         map;
+    int         mission;
+    int         leveltime;
+    int         prndindex;
+} snapshot_t;
+
+static snapshot_t       snapshots[NUMSNAPSHOTS];
+static int              snapshotslot = -1;      // waiting for its savegame
+
+// A snapshot can only be loaded once its savegame has been written, so it
+// is never restored if the savegame on disk is different.
+static void P_FinishSnapshot(boolean written)
+{
+    if (snapshotslot >= 0)
+    {
+        snapshots[snapshotslot].valid = written;
+        snapshotslot = -1;
+    }
+}
+
+//
+// P_SaveSnapshot
+// Copy the playsim just archived for a savegame into a snapshot slot. It
+// must be called after P_WriteSaveGameEOF() and before
+// P_WriteSaveGameFile().
+//
+void P_SaveSnapshot(int slot, char *description)
+{
+    snapshot_t  *snapshot;
+    size_t      start = savesection[SECTION_PLAYERS];
+    size_t      length = savesection[NUMSECTIONS] - start;
+
+    if (slot < 0 || slot >= NUMSNAPSHOTS || gamestate != GS_LEVEL)
+        return;
+
+    // finish with the last savegame first, so its snapshot is dealt with
+    P_FinishSaveGame();
+
+    snapshot = &snapshots[slot];
+
+    // leave out the header, but keep the sections at the same alignment,
+    // as the padding in them depends on it
+    snapshot->start = (start & 3);
+    snapshot->length = snapshot->start + length;
+
+    if (snapshot->length > snapshot->buffersize)
+    {
+        snapshot->buffersize = snapshot->length;
+        snapshot->buffer = realloc(snapshot->buffer, snapshot->buffersize);
+    }
+
+    memcpy(snapshot->buffer + snapshot->start, savebuffer + start, length);
+
+    // only valid once the savegame has been written
+    snapshot->valid = false;
+    snapshotslot = slot;
+    M_StringCopy(snapshot->description, description, SAVESTRINGSIZE);
+    snapshot->skill = gameskill;
+    snapshot->episode = gameepisode;
+    snapshot->map = gamemap;
+    snapshot->mission = gamemission;
+    snapshot->leveltime = leveltime;
+    snapshot->prndindex = prndindex;
+}
+
+//
+// P_LoadSnapshot
+// Restore the playsim from a snapshot slot. Returns false if there is no
+// snapshot in the slot, or it is of another level.
+//
+boolean P_LoadSnapshot(int slot, char *description)
+{
+    snapshot_t  *snapshot;
+    byte        *buffer = savebuffer;
+    size_t      buffersize = savebuffersize;
+
+    if (slot < 0 || slot >= NUMSNAPSHOTS || gamestate != GS_LEVEL)
+        return false;
+
+    snapshot = &snapshots[slot];
+
+    if (!snapshot->valid
+        || snapshot->skill != gameskill
+        || snapshot->episode != gameepisode
+        || snapshot->map != gamemap
+        || snapshot->mission != gamemission)
+        return false;
+
+    // nothing may be left pointing at the thinkers that are about to go
+    S_StopSounds();
+    activeceilingshead = NULL;
+    activeplatshead = NULL;
+    memset(buttonlist, 0, sizeof(buttonlist));
+    bloodSplatQueueSlot = 0;
+    memset(bloodSplatQueue, 0, sizeof(mobj_t *) * bloodsplats);
+
+    savebuffer = snapshot->buffer;
+    savebuffersize = snapshot->buffersize;
+    save_p = savebuffer + snapshot->start;
+    save_end = savebuffer + snapshot->length;
+    savegame_error = false;
+
+    leveltime = snapshot->leveltime;
+    prndindex = snapshot->prndindex;
+
+    P_UnArchivePlayers();
+    P_UnArchiveWorld();
+    P_UnArchiveThinkers();
+    P_UnArchiveSpecials();
+
+    P_RestoreTargets();
+
+    P_MapEnd();
+
+    savebuffer = buffer;
+    savebuffersize = buffersize;
+
+    // removing the old things queued their items to respawn
+    iqueuehead = iqueuetail = 0;
+
+    M_StringCopy(description, snapshot->description, SAVESTRINGSIZE);
+
+    return true;
+}
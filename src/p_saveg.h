@@ -52,6 +52,21 @@ char *P_TempSaveGameFile(void);
 // filename to use for a savegame slot
 char *P_SaveGameFile(int slot);
 
+// Read a savegame file into memory, or start one there, and write it out
+boolean P_OpenSaveGame(char *filename);
+void P_CreateSaveGame(void);
+typedef enum
+{
+    SAVE_NONE,
+    SAVE_WRITING,
+    SAVE_WRITTEN,
+    SAVE_FAILED
+} savestatus_t;
+
+void P_WriteSaveGameFile(char *tempfile, char *filename);
+savestatus_t P_SaveGameStatus(void);
+savestatus_t P_WaitForSaveGame(void);
+
 // Savegame file header read/write functions
 boolean P_ReadSaveGameHeader(char *description);
 void P_WriteSaveGameHeader(char *description);
@@ -64,6 +79,7 @@ void P_WriteSaveGameEOF(void);
 // These are the load / save game routines.
 void P_ArchivePlayers(void);
 void P_UnArchivePlayers(void);
+void P_SnapshotWorld(void);
 void P_ArchiveWorld(void);
 void P_UnArchiveWorld(void);
 void P_ArchiveThinkers(void);
@@ -71,11 +87,16 @@ void P_UnArchiveThinkers(void);
 void P_ArchiveSpecials(void);
 void P_UnArchiveSpecials(void);
 
+// In-memory snapshots of the playsim, for loading quickly or rewinding
+#define NUMSNAPSHOTS            16
+
+void P_SaveSnapshot(int slot, char *description);
+boolean P_LoadSnapshot(int slot, char *description);
+
 uint32_t P_ThinkerToIndex(thinker_t *thinker);
 thinker_t *P_IndexToThinker(uint32_t index);
 void P_RestoreTargets(void);
 
-extern FILE *save_stream;
 extern boolean savegame_error;
 
 #endif
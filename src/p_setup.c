@@ -42,11 +42,15 @@
 #include "g_game.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
 #include "m_bbox.h"
 #include "m_misc.h"
 #include "p_fix.h"
 #include "p_local.h"
+#include "p_saveg.h"
 #include "s_sound.h"
+#include "SDL.h"
 #include "w_wad.h"
 #include "z_zone.h"
 
@@ -99,7 +103,12 @@ fixed_t         bmaporgx;
 fixed_t         bmaporgy;
 
 // for thing chains
-mobj_t          **blocklinks;
+blockthings_t   *blockthings;
+
+// packed lines in each block
+blockline_t     *blocklines;
+int             *blocklinesindex;
+int             *linevalidcount;
 
 // REJECT
 // For fast sight rejection.
@@ -150,6 +159,16 @@ static void *calloc_IfSameLevel(void *p, size_t n1, size_t n2)
     }
 }
 
+// The lumps of the level being loaded, cached by P_SetupLevel() before
+// the loaders run, so that they don't need to touch the zone
+static int      maplumpnum;
+static void     *maplumps[ML_BLOCKMAP + 1];
+
+static void *P_MapLump(int lump)
+{
+    return maplumps[lump - maplumpnum];
+}
+
 #define DEFAULT 0x7fff
 
 //
@@ -168,7 +187,7 @@ void P_LoadVertexes(int lump)
     vertexes = calloc_IfSameLevel(vertexes, numvertexes, sizeof(vertex_t));
 
     // Load data into cache.
-    data = (const mapvertex_t *)W_CacheLumpNum(lump, PU_STATIC);
+    data = (const mapvertex_t *)P_MapLump(lump);
 
     // Copy and convert vertex coordinates,
     // internal representation as fixed.
@@ -180,28 +199,24 @@ void P_LoadVertexes(int lump)
         // Apply any map-specific fixes.
         if (canmodify && (mapfixes & VERTEXES))
         {
-            int j = 0;
+            mapfix_t    *fixes;
+            int         count = P_GetMapFixes(FIX_VERTEXES, i, &fixes);
+            int         j;
 
-            while (vertexfix[j].mission != -1)
+            for (j = 0; j < count; j++)
             {
-                if (i == vertexfix[j].vertex
-                    && gamemission == vertexfix[j].mission
-                    && gameepisode == vertexfix[j].epsiode
-                    && gamemap == vertexfix[j].map
-                    && vertexes[i].x == SHORT(vertexfix[j].oldx) << FRACBITS
-                    && vertexes[i].y == SHORT(vertexfix[j].oldy) << FRACBITS)
+                vertexfix_t     *fix = &vertexfix[fixes[j].fix];
+
+                if (vertexes[i].x == SHORT(fix->oldx) << FRACBITS
+                    && vertexes[i].y == SHORT(fix->oldy) << FRACBITS)
                 {
-                    vertexes[i].x = SHORT(vertexfix[j].newx) << FRACBITS;
-                    vertexes[i].y = SHORT(vertexfix[j].newy) << FRACBITS;
+                    vertexes[i].x = SHORT(fix->newx) << FRACBITS;
+                    vertexes[i].y = SHORT(fix->newy) << FRACBITS;
                     break;
                 }
-                j++;
             }
         }
     }
-
-    // Free buffer memory.
-    W_ReleaseLumpNum(lump);
 }
 
 //
@@ -215,7 +230,7 @@ void P_LoadSegs(int lump)
     numsegs = W_LumpLength(lump) / sizeof(mapseg_t);
     segs = calloc_IfSameLevel(segs, numsegs, sizeof(seg_t));
     memset(segs, 0, numsegs * sizeof(seg_t));
-    data = (const mapseg_t *)W_CacheLumpNum(lump, PU_STATIC);
+    data = (const mapseg_t *)P_MapLump(lump);
 
     for (i = 0; i < numsegs; i++)
     {
@@ -311,15 +326,15 @@ void P_LoadSegs(int lump)
         // Apply any map-specific fixes.
         if (canmodify && (mapfixes & LINEDEFS))
         {
-            int j = 0;
+            mapfix_t    *fixes;
+            int         count = P_GetMapFixes(FIX_LINEDEFS, linedef, &fixes);
+            int         k;
 
-            while (linefix[j].mission != -1)
+            for (k = 0; k < count; k++)
             {
-                if (linedef == linefix[j].linedef
-                    && gamemission == linefix[j].mission
-                    && gameepisode == linefix[j].epsiode
-                    && gamemap == linefix[j].map
-                    && side == linefix[j].side)
+                int     j = fixes[k].fix;
+
+                if (side == linefix[j].side)
                 {
                     if (linefix[j].toptexture[0] != '\0')
                         li->sidedef->toptexture = R_TextureNumForName(linefix[j].toptexture);
@@ -349,12 +364,9 @@ void P_LoadSegs(int lump)
                         li->linedef->tag = linefix[j].tag;
                     break;
                 }
-                j++;
             }
         }
     }
-
-    W_ReleaseLumpNum(lump);
 }
 
 //
@@ -367,7 +379,7 @@ void P_LoadSubsectors(int lump)
 
     numsubsectors = W_LumpLength(lump) / sizeof(mapsubsector_t);
     subsectors = calloc_IfSameLevel(subsectors, numsubsectors, sizeof(subsector_t));
-    data = (const mapsubsector_t *)W_CacheLumpNum(lump, PU_STATIC);
+    data = (const mapsubsector_t *)P_MapLump(lump);
 
     memset(subsectors, 0, numsubsectors * sizeof(subsector_t));
 
@@ -376,8 +388,6 @@ void P_LoadSubsectors(int lump)
         subsectors[i].numlines = (unsigned short)SHORT(data[i].numsegs);
         subsectors[i].firstline = (unsigned short)SHORT(data[i].firstseg);
     }
-
-    W_ReleaseLumpNum(lump);
 }
 
 //
@@ -391,7 +401,7 @@ void P_LoadSectors(int lump)
     numsectors = W_LumpLength(lump) / sizeof(mapsector_t);
     sectors = calloc_IfSameLevel(sectors, numsectors, sizeof(sector_t));
     memset(sectors, 0, numsectors * sizeof(sector_t));
-    data = (byte *)W_CacheLumpNum(lump, PU_STATIC);
+    data = (byte *)P_MapLump(lump);
 
     for (i = 0; i < numsectors; i++)
     {
@@ -409,35 +419,28 @@ void P_LoadSectors(int lump)
         // Apply any level-specific fixes.
         if (canmodify && (mapfixes & SECTORS))
         {
-            int j = 0;
+            mapfix_t    *fixes;
+            int         count = P_GetMapFixes(FIX_SECTORS, i, &fixes);
 
-            while (sectorfix[j].mission != -1)
+            if (count)
             {
-                if (i == sectorfix[j].sector
-                    && gamemission == sectorfix[j].mission
-                    && gameepisode == sectorfix[j].epsiode
-                    && gamemap == sectorfix[j].map)
-                {
-                    if (sectorfix[j].floorpic[0] != '\0')
-                        ss->floorpic = R_FlatNumForName(sectorfix[j].floorpic);
-                    if (sectorfix[j].ceilingpic[0] != '\0')
-                        ss->ceilingpic = R_FlatNumForName(sectorfix[j].ceilingpic);
-                    if (sectorfix[j].floorheight != DEFAULT)
-                        ss->floorheight = SHORT(sectorfix[j].floorheight) << FRACBITS;
-                    if (sectorfix[j].ceilingheight != DEFAULT)
-                        ss->ceilingheight = SHORT(sectorfix[j].ceilingheight) << FRACBITS;
-                    if (sectorfix[j].special != DEFAULT)
-                        ss->special = SHORT(sectorfix[j].special) << FRACBITS;
-                    if (sectorfix[j].tag != DEFAULT)
-                        ss->tag = SHORT(sectorfix[j].tag) << FRACBITS;
-                    break;
-                }
-                j++;
+                int     j = fixes[0].fix;
+
+                if (sectorfix[j].floorpic[0] != '\0')
+                    ss->floorpic = R_FlatNumForName(sectorfix[j].floorpic);
+                if (sectorfix[j].ceilingpic[0] != '\0')
+                    ss->ceilingpic = R_FlatNumForName(sectorfix[j].ceilingpic);
+                if (sectorfix[j].floorheight != DEFAULT)
+                    ss->floorheight = SHORT(sectorfix[j].floorheight) << FRACBITS;
+                if (sectorfix[j].ceilingheight != DEFAULT)
+                    ss->ceilingheight = SHORT(sectorfix[j].ceilingheight) << FRACBITS;
+                if (sectorfix[j].special != DEFAULT)
+                    ss->special = SHORT(sectorfix[j].special) << FRACBITS;
+                if (sectorfix[j].tag != DEFAULT)
+                    ss->tag = SHORT(sectorfix[j].tag) << FRACBITS;
             }
         }
     }
-
-    W_ReleaseLumpNum(lump);
 }
 
 //
@@ -450,7 +453,7 @@ void P_LoadNodes(int lump)
 
     numnodes = W_LumpLength(lump) / sizeof(mapnode_t);
     nodes = malloc_IfSameLevel(nodes, numnodes * sizeof(node_t));
-    data = (byte *)W_CacheLumpNum(lump, PU_STATIC);
+    data = (byte *)P_MapLump(lump);
 
     for (i = 0; i < numnodes; i++)
     {
@@ -487,8 +490,6 @@ void P_LoadNodes(int lump)
                 no->bbox[j][k] = SHORT(mn->bbox[j][k]) << FRACBITS;
         }
     }
-
-    W_ReleaseLumpNum(lump);
 }
 
 //
@@ -502,6 +503,7 @@ void P_LoadThings(int lump)
 
     data = (const mapthing_t *)W_CacheLumpNum(lump, PU_STATIC);
     numthings = W_LumpLength(lump) / sizeof(mapthing_t);
+    P_InitSecNodeList(numthings);
 
     for (i = 0; i < numthings; i++)
     {
@@ -540,15 +542,15 @@ void P_LoadThings(int lump)
         // Apply any level-specific fixes.
         if (canmodify && (mapfixes & THINGS))
         {
-            int j = 0;
+            mapfix_t    *fixes;
+            int         count = P_GetMapFixes(FIX_THINGS, i, &fixes);
+            int         k;
 
-            while (thingfix[j].mission != -1)
+            for (k = 0; k < count; k++)
             {
-                if (gamemission == thingfix[j].mission
-                    && gameepisode == thingfix[j].epsiode
-                    && gamemap == thingfix[j].map
-                    && i == thingfix[j].thing
-                    && mt.type == thingfix[j].type
+                int     j = fixes[k].fix;
+
+                if (mt.type == thingfix[j].type
                     && mt.x == SHORT(thingfix[j].oldx)
                     && mt.y == SHORT(thingfix[j].oldy))
                 {
@@ -565,7 +567,6 @@ void P_LoadThings(int lump)
                         mt.options = thingfix[j].options;
                     break;
                 }
-                j++;
             }
         }
 
@@ -586,7 +587,7 @@ void P_LoadThings(int lump)
 //
 void P_LoadLineDefs(int lump)
 {
-    const byte  *data = W_CacheLumpNum(lump, PU_STATIC);
+    const byte  *data = P_MapLump(lump);
     int         i;
 
     numlines = W_LumpLength(lump) / sizeof(maplinedef_t);
@@ -668,8 +669,6 @@ void P_LoadLineDefs(int lump)
         ld->frontsector = (ld->sidenum[0] == NO_INDEX ? 0 : sides[ld->sidenum[0]].sector);
         ld->backsector = (ld->sidenum[1] == NO_INDEX ? 0 : sides[ld->sidenum[1]].sector);
     }
-
-    W_ReleaseLumpNum(lump);
 }
 
 //
@@ -683,7 +682,7 @@ void P_LoadSideDefs(int lump)
     numsides = W_LumpLength(lump) / sizeof(mapsidedef_t);
     sides = calloc_IfSameLevel(sides, numsides, sizeof(side_t));
     memset(sides, 0, numsides * sizeof(side_t));
-    data = (byte *)W_CacheLumpNum(lump, PU_STATIC);
+    data = (byte *)P_MapLump(lump);
 
     for (i = 0; i < numsides; i++)
     {
@@ -703,33 +702,188 @@ void P_LoadSideDefs(int lump)
         sd->bottomtexture = R_TextureNumForName(msd->bottomtexture);
         sd->midtexture = R_TextureNumForName(msd->midtexture);
     }
+}
 
-    W_ReleaseLumpNum(lump);
+// Lines in each block while creating a blockmap
+typedef struct
+{
+    int         count;
+    int         max;
+    int         *lines;
+} bmaplist_t;
+
+static void P_AddLineToBlockList(bmaplist_t *list, int linenum)
+{
+    if (list->count == list->max)
+    {
+        list->max = (list->max ? list->max * 2 : 8);
+        list->lines = realloc(list->lines, list->max * sizeof(*list->lines));
+    }
+    list->lines[list->count++] = linenum;
+}
+
+static int FloorDiv(int64_t n, int64_t d)
+{
+    int64_t     q = n / d;
+
+    return (int)(q - (n % d && n < 0));
+}
+
+static int CeilDiv(int64_t n, int64_t d)
+{
+    int64_t     q = n / d;
+
+    return (int)(q + (n % d && n > 0));
 }
 
 //
-// P_LoadBlockMap
+// P_CreateBlockMap
+// Build the blockmap from the linedefs, for levels whose BLOCKMAP lump is
+// missing, corrupt or too big to be addressed by 16-bit offsets.
+// Each line is listed in every block it passes through, or touches the
+// edge of, working across one column of blocks at a time. Lists don't
+// start with the dummy 0 entry that node builders emit, and all empty
+// blocks share the same list.
 //
+static void P_CreateBlockMap(void)
+{
+    int         minx = INT_MAX, miny = INT_MAX;
+    int         maxx = INT_MIN, maxy = INT_MIN;
+    int         numblocks;
+    int         count;
+    int         i;
+    bmaplist_t  *bmap;
+
+    for (i = 0; i < numlines; i++)
+    {
+        vertex_t        *v[2];
+        int             j;
+
+        v[0] = lines[i].v1;
+        v[1] = lines[i].v2;
+        for (j = 0; j < 2; j++)
+        {
+            int x = v[j]->x >> FRACBITS;
+            int y = v[j]->y >> FRACBITS;
+
+            minx = MIN(minx, x);
+            maxx = MAX(maxx, x);
+            miny = MIN(miny, y);
+            maxy = MAX(maxy, y);
+        }
+    }
+
+    if (!numlines)
+        minx = maxx = miny = maxy = 0;
+
+    bmaporgx = minx << FRACBITS;
+    bmaporgy = miny << FRACBITS;
+    bmapwidth = ((maxx - minx) >> MAPBTOFRAC) + 1;
+    bmapheight = ((maxy - miny) >> MAPBTOFRAC) + 1;
+    numblocks = bmapwidth * bmapheight;
+
+    bmap = calloc(numblocks, sizeof(*bmap));
+
+    for (i = 0; i < numlines; i++)
+    {
+        int     x1 = (lines[i].v1->x >> FRACBITS) - minx;
+        int     y1 = (lines[i].v1->y >> FRACBITS) - miny;
+        int     x2 = (lines[i].v2->x >> FRACBITS) - minx;
+        int     y2 = (lines[i].v2->y >> FRACBITS) - miny;
+        int     bx;
+
+        // work from left to right
+        if (x1 > x2)
+        {
+            int temp = x1;
+
+            x1 = x2;
+            x2 = temp;
+            temp = y1;
+            y1 = y2;
+            y2 = temp;
+        }
+
+        for (bx = x1 >> MAPBTOFRAC; bx <= x2 >> MAPBTOFRAC; bx++)
+        {
+            // the part of the line in this column of blocks
+            int xa = MAX(x1, bx << MAPBTOFRAC);
+            int xb = MIN(x2, (bx + 1) << MAPBTOFRAC);
+            int ylo, yhi;
+            int by;
+
+            if (x1 == x2)
+            {
+                ylo = MIN(y1, y2);
+                yhi = MAX(y1, y2);
+            }
+            else
+            {
+                // rounded outwards so no block the line passes through is missed
+                int64_t na = (int64_t)(xa - x1) * (y2 - y1);
+                int64_t nb = (int64_t)(xb - x1) * (y2 - y1);
+                int64_t d = x2 - x1;
+
+                ylo = y1 + MIN(FloorDiv(na, d), FloorDiv(nb, d));
+                yhi = y1 + MAX(CeilDiv(na, d), CeilDiv(nb, d));
+                ylo = MAX(ylo, MIN(y1, y2));
+                yhi = MIN(yhi, MAX(y1, y2));
+            }
+
+            for (by = ylo >> MAPBTOFRAC; by <= yhi >> MAPBTOFRAC; by++)
+                P_AddLineToBlockList(&bmap[by * bmapwidth + bx], i);
+        }
+    }
+
+    // header, offsets, one shared empty list and a -1 terminated list for each other block
+    count = 4 + numblocks + 1;
+    for (i = 0; i < numblocks; i++)
+        if (bmap[i].count)
+            count += bmap[i].count + 1;
+
+    blockmaphead = malloc(sizeof(*blockmaphead) * count);
+    blockmaphead[0] = minx;
+    blockmaphead[1] = miny;
+    blockmaphead[2] = bmapwidth;
+    blockmaphead[3] = bmapheight;
+    blockmapindex = &blockmaphead[4];
+
+    count = 4 + numblocks;
+    blockmaphead[count] = (uint32_t)(-1);
+
+    for (i = 0, count++; i < numblocks; i++)
+    {
+        if (bmap[i].count)
+        {
+            blockmapindex[i] = count;
+            memcpy(&blockmaphead[count], bmap[i].lines, bmap[i].count * sizeof(*blockmaphead));
+            count += bmap[i].count;
+            blockmaphead[count++] = (uint32_t)(-1);
+            free(bmap[i].lines);
+        }
+        else
+            blockmapindex[i] = 4 + numblocks;
+    }
+
+    free(bmap);
+}
+
+//
+// P_ExpandBlockMap
 // Read wad blockmap using int16_t wadblockmaplump[].
 // Expand from 16bit wad to internal 32bit blockmap.
+// Returns false if the blockmap is corrupt.
 // (Taken from Doom Legacy)
 //
-void P_LoadBlockMap(int lump)
+static boolean P_ExpandBlockMap(int lump)
 {
     unsigned int        count = W_LumpLength(lump) / 2;                    // number of 16 bit blockmap entries
-    uint16_t            *wadblockmaplump = W_CacheLumpNum(lump, PU_LEVEL); // blockmap lump temp
+    uint16_t            *wadblockmaplump = P_MapLump(lump);                // blockmap lump temp
     uint32_t            firstlist, lastlist;  // blockmap block list bounds
-    uint32_t            overflow_corr = 0;
-    uint32_t            prev_bme = 0;  // for detecting overflow wrap
     unsigned int        i;
 
-    // [WDJ] when zennode has not been run, this code will corrupt Zone memory.
-    // It assumes a minimum size blockmap.
-    if (count < 5)
-        I_Error("Missing blockmap, node builder has not been run.\n");
-
     // [WDJ] Do endian as read from blockmap lump temp
-    blockmaphead = malloc_IfSameLevel(blockmaphead, sizeof(*blockmaphead) * count);
+    blockmaphead = malloc(sizeof(*blockmaphead) * count);
 
     // killough 3/1/98: Expand wad blockmap into larger internal one,
     // by treating all offsets except -1 as unsigned and zero-extending
@@ -750,42 +904,17 @@ void P_LoadBlockMap(int lump)
     lastlist = count - 1;
 
     if (firstlist >= lastlist || bmapwidth < 1 || bmapheight < 1)
-        I_Error("Blockmap corrupt, must run node builder on wad.\n");
+        return false;
 
     // read blockmap index array
     for (i = 4; i < firstlist; i++)                             // for all entries in wad offset index
     {
         uint32_t        bme = LE_SWAP16(wadblockmaplump[i]);    // offset
 
-        // upon overflow, the bme will wrap to low values
-        if (bme < firstlist                                     // too small to be valid
-            && bme < 0x1000 && prev_bme > 0xf000)               // wrapped
-        {
-            // first or repeated overflow
-            overflow_corr += 0x00010000;
-        }
-        prev_bme = bme;                                         // uncorrected
-
-        // correct for overflow, or else try without correction
-        if (overflow_corr)
-        {
-            uint32_t    bmec = bme + overflow_corr;
-
-            // First entry of list is 0, but high odds of hitting one randomly.
-            // Check for valid blockmap offset, and offset overflow
-            if (bmec <= lastlist
-                && wadblockmaplump[bmec] == 0                   // valid start list
-                && bmec - blockmaphead[i - 1] < 1000)           // reasonably close sequentially
-            {
-                bme = bmec;
-            }
-        }
-
-        if (bme > lastlist)
-            I_Error("Blockmap offset[%i]= %i, exceeds bounds.\n", i, bme);
-        if (bme < firstlist
+        if (bme > lastlist                                      // exceeds bounds
+            || bme < firstlist
             || wadblockmaplump[bme] != 0)                       // not start list
-            I_Error("Bad blockmap offset[%i]= %i.\n", i, bme);
+            return false;
         blockmaphead[i] = bme;
     }
 
@@ -799,9 +928,115 @@ void P_LoadBlockMap(int lump)
         blockmaphead[i] = (bme == 0xffff ? (uint32_t)(-1) : (uint32_t)bme);
     }
 
+    return true;
+}
+
+//
+// P_ClearBlockThings
+// Empty every mapblock of things, optionally freeing their arrays too.
+//
+static void P_ClearBlockThings(boolean freeblocks)
+{
+    int i;
+
+    for (i = 0; i < bmapwidth * bmapheight; i++)
+    {
+        blockthings_t   *block = &blockthings[i];
+
+        if (freeblocks)
+        {
+            free(block->mobj);
+            block->mobj = NULL;
+            block->x = block->y = block->radius = NULL;
+            block->max = 0;
+        }
+        block->count = 0;
+        block->holes = 0;
+    }
+}
+
+static boolean  createblockmap;
+
+//
+// P_LoadBlockMap
+// Use the level's blockmap if it's usable, otherwise create one.
+// Must be called after P_LoadLineDefs().
+//
+void P_LoadBlockMap(int lump)
+{
+    unsigned int        count = W_LumpLength(lump) / 2;
+
+    // the blockmap is kept when the same level is loaded again
+    if (samelevel)
+    {
+        P_ClearBlockThings(false);
+        return;
+    }
+
+    // Blockmaps with 0x10000 or more entries will have overflowed their
+    // 16-bit offsets, so don't bother trying to make sense of them.
+    if (createblockmap || count < 5 || count >= 0x10000)
+        P_CreateBlockMap();
+    else if (!P_ExpandBlockMap(lump))
+    {
+        free(blockmaphead);
+        P_CreateBlockMap();
+    }
+
     // clear out mobj chains
-    blocklinks = calloc_IfSameLevel(blocklinks, bmapwidth * bmapheight, sizeof(*blocklinks));
-    memset(blocklinks, 0, sizeof(*blocklinks) * bmapwidth * bmapheight);
+    blockthings = calloc(bmapwidth * bmapheight, sizeof(*blockthings));
+}
+
+//
+// P_SetupBlockLines
+// Copy the lines listed in each mapblock into one packed array, so that
+// blocks can be scanned for collisions without going through line_t.
+// Called after P_RemoveSlimeTrails(), which may move some vertexes.
+//
+static void P_SetupBlockLines(void)
+{
+    int numblocks = bmapwidth * bmapheight;
+    int count = 0;
+    int i;
+
+    for (i = 0; i < numblocks; i++)
+    {
+        const uint32_t  *list;
+
+        for (list = &blockmaphead[blockmapindex[i]]; *list != (uint32_t)(-1); list++)
+            if (*list < (uint32_t)numlines)
+                count++;
+    }
+
+    blocklinesindex = malloc_IfSameLevel(blocklinesindex, (numblocks + 1) * sizeof(*blocklinesindex));
+    blocklines = malloc_IfSameLevel(blocklines, MAX(1, count) * sizeof(*blocklines));
+    linevalidcount = calloc_IfSameLevel(linevalidcount, MAX(1, numlines), sizeof(*linevalidcount));
+
+    count = 0;
+    for (i = 0; i < numblocks; i++)
+    {
+        const uint32_t  *list;
+
+        blocklinesindex[i] = count;
+
+        for (list = &blockmaphead[blockmapindex[i]]; *list != (uint32_t)(-1); list++)
+            if (*list < (uint32_t)numlines)
+            {
+                line_t          *ld = &lines[*list];
+                blockline_t     *bl = &blocklines[count++];
+
+                memcpy(bl->bbox, ld->bbox, sizeof(bl->bbox));
+                bl->x1 = ld->v1->x;
+                bl->y1 = ld->v1->y;
+                bl->x2 = ld->v2->x;
+                bl->y2 = ld->v2->y;
+                bl->dx = ld->dx;
+                bl->dy = ld->dy;
+                bl->slopetype = ld->slopetype;
+                bl->linenum = *list;
+            }
+    }
+    blocklinesindex[numblocks] = count;
 }
 
 //
@@ -1116,6 +1351,287 @@ void P_MapName(int episode, int map)
     }
 }
 
+//
+// P_LoadReject
+//
+static void P_LoadReject(int lump)
+{
+    rejectmatrix = (byte *)W_CacheLumpNum(lump, PU_LEVEL);
+    rejectmatrixsize = W_LumpLength(lump);
+}
+
+//
+// Loading stages
+// Once a level's lumps have been cached, the stages that load it run on as
+// many threads as there are CPUs, each as soon as the stages it depends on
+// are done. Only the main thread runs those stages that use the zone.
+//
+enum
+{
+    LOAD_VERTEXES,
+    LOAD_SECTORS,
+    LOAD_SIDEDEFS,
+    LOAD_LINEDEFS,
+    LOAD_BLOCKMAP,
+    LOAD_SUBSECTORS,
+    LOAD_NODES,
+    LOAD_SEGS,
+    LOAD_REJECT,
+    LOAD_GROUPLINES,
+    LOAD_SLIMETRAILS,
+    LOAD_BLOCKLINES,
+    NUMLOADSTAGES,
+
+    // the rest of P_SetupLevel(), timed but not run as stages
+    LOAD_SOUND = NUMLOADSTAGES,
+    LOAD_LUMPS,
+    LOAD_THINGS,
+    LOAD_SPECIALS,
+    LOAD_PRECACHE,
+    LOAD_MUSIC,
+    NUMLOADSTATS
+};
+
+#define AFTER(stage)    (1 << (stage))
+#define ALLLOADSTAGES   ((1 << NUMLOADSTAGES) - 1)
+
+typedef struct
+{
+    void        (*load)(int lump);
+    void        (*run)(void);
+    int         lump;
+    int         after;          // stages that must be done first
+    boolean     mainthread;     // uses the zone
+} loadstage_t;
+
+static loadstage_t loadstages[NUMLOADSTAGES] =
+{
+    { P_LoadVertexes,   NULL,                ML_VERTEXES, 0,                                                       false },
+    { P_LoadSectors,    NULL,                ML_SECTORS,  0,                                                       false },
+    { P_LoadSideDefs,   NULL,                ML_SIDEDEFS, AFTER(LOAD_SECTORS),                                     false },
+    { P_LoadLineDefs,   NULL,                ML_LINEDEFS, AFTER(LOAD_VERTEXES) | AFTER(LOAD_SIDEDEFS),             false },
+    { P_LoadBlockMap,   NULL,                ML_BLOCKMAP, AFTER(LOAD_LINEDEFS),                                    false },
+    { P_LoadSubsectors, NULL,                ML_SSECTORS, 0,                                                       false },
+    { P_LoadNodes,      NULL,                ML_NODES,    AFTER(LOAD_SUBSECTORS),                                  false },
+    { P_LoadSegs,       NULL,                ML_SEGS,     AFTER(LOAD_LINEDEFS),                                    false },
+    { P_LoadReject,     NULL,                ML_REJECT,   0,                                                       true  },
+    { NULL,             P_GroupLines,        0,           AFTER(LOAD_BLOCKMAP) | AFTER(LOAD_SUBSECTORS)
+                                                          | AFTER(LOAD_SEGS),                                      true  },
+    { NULL,             P_RemoveSlimeTrails, 0,           AFTER(LOAD_GROUPLINES),                                  false },
+    { NULL,             P_SetupBlockLines,   0,           AFTER(LOAD_SLIMETRAILS),                                 false }
+};
+
+static SDL_mutex        *loadmutex;
+static SDL_cond         *loadcond;
+static int              loadstarted;
+static int              loaddone;
+
+//
+// Load stats
+// How long each part of loading a level took, and, for those run on the
+// main thread, how much was read from lumps and allocated in the zone.
+// Enabled with -loadstats, and written out as a line of JSON per level.
+//
+typedef struct
+{
+    char        *name;
+    uint64_t    time;           // in microseconds
+    size_t      bytesread;
+    int         allocations;
+    size_t      allocated;
+} loadstat_t;
+
+static loadstat_t loadstats[NUMLOADSTATS] =
+{
+    { "vertexes",    0, 0, 0, 0 },
+    { "sectors",     0, 0, 0, 0 },
+    { "sidedefs",    0, 0, 0, 0 },
+    { "linedefs",    0, 0, 0, 0 },
+    { "blockmap",    0, 0, 0, 0 },
+    { "subsectors",  0, 0, 0, 0 },
+    { "nodes",       0, 0, 0, 0 },
+    { "segs",        0, 0, 0, 0 },
+    { "reject",      0, 0, 0, 0 },
+    { "grouplines",  0, 0, 0, 0 },
+    { "slimetrails", 0, 0, 0, 0 },
+    { "blocklines",  0, 0, 0, 0 },
+    { "sound",       0, 0, 0, 0 },
+    { "lumps",       0, 0, 0, 0 },
+    { "things",      0, 0, 0, 0 },
+    { "specials",    0, 0, 0, 0 },
+    { "precache",    0, 0, 0, 0 },
+    { "music",       0, 0, 0, 0 }
+};
+
+static FILE             *loadstatsfile;
+
+// Start timing a stat. Only the main thread counts what's read and allocated.
+static void P_StartLoadStat(int stat, boolean mainthread)
+{
+    loadstat_t  *loadstat = &loadstats[stat];
+
+    loadstat->time = I_GetTimeUS();
+    if (mainthread)
+    {
+        loadstat->bytesread = lumpbytesread;
+        loadstat->allocations = zoneallocations;
+        loadstat->allocated = zoneallocated;
+    }
+}
+
+static void P_EndLoadStat(int stat, boolean mainthread)
+{
+    loadstat_t  *loadstat = &loadstats[stat];
+
+    loadstat->time = I_GetTimeUS() - loadstat->time;
+    if (mainthread)
+    {
+        loadstat->bytesread = lumpbytesread - loadstat->bytesread;
+        loadstat->allocations = zoneallocations - loadstat->allocations;
+        loadstat->allocated = zoneallocated - loadstat->allocated;
+    }
+    else
+    {
+        loadstat->bytesread = 0;
+        loadstat->allocations = 0;
+        loadstat->allocated = 0;
+    }
+}
+
+// Write a string as JSON, escaping the backslashes in paths
+static void P_WriteJSONString(FILE *file, char *string)
+{
+    fputc('"', file);
+    for (; *string; string++)
+    {
+        if (*string == '"' || *string == '\\')
+            fputc('\\', file);
+        fputc(*string, file);
+    }
+    fputc('"', file);
+}
+
+static void P_WriteLoadStats(char *lumpname, int lumpnum, uint64_t total)
+{
+    int i;
+
+    if (loadstatsfile)
+    {
+        fprintf(loadstatsfile, "{\"map\":\"%s\",\"wad\":", lumpname);
+        P_WriteJSONString(loadstatsfile, lumpinfo[lumpnum].wad_file->path);
+        fprintf(loadstatsfile, ",\"time\":%llu,\"stages\":[", (unsigned long long)total);
+
+        for (i = 0; i < NUMLOADSTATS; i++)
+            fprintf(loadstatsfile, "%s{\"name\":\"%s\",\"time\":%llu,\"bytesread\":%lu,"
+                "\"allocations\":%i,\"allocated\":%lu}", (i ? "," : ""), loadstats[i].name,
+                (unsigned long long)loadstats[i].time, (unsigned long)loadstats[i].bytesread,
+                loadstats[i].allocations, (unsigned long)loadstats[i].allocated);
+
+        fprintf(loadstatsfile, "]}\n");
+        fflush(loadstatsfile);
+    }
+
+    if (devparm)
+    {
+        printf("P_SetupLevel:");
+        for (i = 0; i < NUMLOADSTAGES; i++)
+            printf(" %s %i.%03ims", loadstats[i].name, (int)(loadstats[i].time / 1000),
+                (int)(loadstats[i].time % 1000));
+        printf("\n");
+    }
+}
+
+static int P_LoadStagesThread(void *arg)
+{
+    boolean     mainthread = (arg != NULL);
+
+    SDL_LockMutex(loadmutex);
+
+    while (loaddone != ALLLOADSTAGES)
+    {
+        loadstage_t     *stage = NULL;
+        boolean         waiting = false;
+        int             i;
+
+        for (i = 0; i < NUMLOADSTAGES; i++)
+            if (!(loadstarted & (1 << i)) && (mainthread || !loadstages[i].mainthread))
+            {
+                if (loadstages[i].after & ~loaddone)
+                    waiting = true;
+                else
+                {
+                    stage = &loadstages[i];
+                    break;
+                }
+            }
+
+        if (stage)
+        {
+            loadstarted |= (1 << i);
+            SDL_UnlockMutex(loadmutex);
+
+            P_StartLoadStat(i, mainthread);
+            if (stage->load)
+                stage->load(maplumpnum + stage->lump);
+            else
+                stage->run();
+            P_EndLoadStat(i, mainthread);
+
+            SDL_LockMutex(loadmutex);
+            loaddone |= (1 << i);
+            SDL_CondBroadcast(loadcond);
+        }
+        else if (waiting || mainthread)
+            SDL_CondWait(loadcond, loadmutex);
+        else
+            break;
+    }
+
+    SDL_UnlockMutex(loadmutex);
+
+    return 0;
+}
+
+//
+// P_LoadLevel
+// Load the level whose marker is lump.
+//
+static void P_LoadLevel(int lump)
+{
+    SDL_Thread  *threads[NUMLOADSTAGES];
+    int         numthreads = 1;
+    int         i;
+
+    P_StartLoadStat(LOAD_LUMPS, true);
+    maplumpnum = lump;
+    for (i = ML_THINGS; i <= ML_BLOCKMAP; i++)
+        if (i != ML_THINGS && i != ML_REJECT)
+            maplumps[i] = W_CacheLumpNum(lump + i, PU_STATIC);
+    P_EndLoadStat(LOAD_LUMPS, true);
+
+    loadstarted = 0;
+    loaddone = 0;
+
+#ifdef SDL20
+    if (loadmutex && loadcond)
+        numthreads = MAX(1, MIN(SDL_GetCPUCount(), NUMLOADSTAGES));
+
+    // this thread runs its share of the stages too
+    for (i = 1; i < numthreads; i++)
+        threads[i] = SDL_CreateThread(P_LoadStagesThread, "level", NULL);
+#endif
+
+    P_LoadStagesThread((void *)1);
+
+    for (i = 1; i < numthreads; i++)
+        if (threads[i])
+            SDL_WaitThread(threads[i], NULL);
+
+    for (i = ML_THINGS; i <= ML_BLOCKMAP; i++)
+        if (i != ML_THINGS && i != ML_REJECT)
+            W_ReleaseLumpNum(lump + i);
+}
+
 extern boolean idclev;
 extern boolean oldweaponsowned[];
 
@@ -1124,9 +1640,10 @@ extern boolean oldweaponsowned[];
 //
 void P_SetupLevel(int episode, int map)
 {
-    int  i;
-    char lumpname[6];
-    int  lumpnum;
+    int         i;
+    char        lumpname[6];
+    int         lumpnum;
+    uint64_t    start = I_GetTimeUS();
 
     totalkills = totalitems = totalsecret = wminfo.maxfrags = 0;
     wminfo.partime = 0;
@@ -1140,7 +1657,9 @@ void P_SetupLevel(int episode, int map)
     idclev = false;
 
     // Make sure all sounds are stopped before Z_FreeTags.
+    P_StartLoadStat(LOAD_SOUND, true);
     S_Start();
+    P_EndLoadStat(LOAD_SOUND, true);
 
     Z_FreeTags(PU_LEVEL, PU_PURGELEVEL - 1);
 
@@ -1161,6 +1680,8 @@ void P_SetupLevel(int episode, int map)
                  || gamemission == pack_nerve
                  || (nerve && gamemission == doom2));
 
+    P_SetMapFixes(gamemission, gameepisode, gamemap);
+
     leveltime = 0;
 
     // e6y: speedup of level reloading
@@ -1175,8 +1696,15 @@ void P_SetupLevel(int episode, int map)
         free(segs);
         free(nodes);
         free(subsectors);
-        free(blocklinks);
+        if (blockthings)
+        {
+            P_ClearBlockThings(true);
+            free(blockthings);
+        }
         free(blockmaphead);
+        free(blocklines);
+        free(blocklinesindex);
+        free(linevalidcount);
         free(lines);
         free(sides);
         free(sectors);
@@ -1185,33 +1713,16 @@ void P_SetupLevel(int episode, int map)
 
     P_MapName(gameepisode, gamemap);
 
-    // note: most of this ordering is important
-    if (!samelevel)
-        P_LoadBlockMap(lumpnum + ML_BLOCKMAP);
-    else
-        memset(blocklinks, 0, bmapwidth * bmapheight * sizeof(*blocklinks));
-
-    P_LoadVertexes(lumpnum + ML_VERTEXES);
-    P_LoadSectors(lumpnum + ML_SECTORS);
-    P_LoadSideDefs(lumpnum + ML_SIDEDEFS);
-
-    P_LoadLineDefs(lumpnum + ML_LINEDEFS);
-    P_LoadSubsectors(lumpnum + ML_SSECTORS);
-    P_LoadNodes(lumpnum + ML_NODES);
-    P_LoadSegs(lumpnum + ML_SEGS);
-
-    rejectmatrix = (byte *)W_CacheLumpNum(lumpnum + ML_REJECT, PU_LEVEL);
-    rejectmatrixsize = W_LumpLength(lumpnum + ML_REJECT);
-    P_GroupLines();
-
-    P_RemoveSlimeTrails();
+    P_LoadLevel(lumpnum);
 
     deathmatch_p = deathmatchstarts;
 
     bloodSplatQueueSlot = 0;
     memset(bloodSplatQueue, 0, sizeof(mobj_t *) * bloodsplats);
 
+    P_StartLoadStat(LOAD_THINGS, true);
     P_LoadThings(lumpnum + ML_THINGS);
+    P_EndLoadStat(LOAD_THINGS, true);
 
     P_InitCards(&players[0]);
 
@@ -1229,13 +1740,27 @@ void P_SetupLevel(int episode, int map)
     // clear special respawning queue
     iqueuehead = iqueuetail = 0;
 
+    // start reading the graphics the level uses in the background, while
+    // the rest of the level is set up
+    P_StartLoadStat(LOAD_PRECACHE, true);
+    R_PrecacheLevel();
+    P_EndLoadStat(LOAD_PRECACHE, true);
+
     // set up world state
+    P_StartLoadStat(LOAD_SPECIALS, true);
     P_SpawnSpecials();
+    P_EndLoadStat(LOAD_SPECIALS, true);
+
+    // remember it so that savegames only need to store what changes
+    P_SnapshotWorld();
 
     P_MapEnd();
 
-    // preload graphics
-    R_PrecacheLevel();
+    P_StartLoadStat(LOAD_MUSIC, true);
+    S_StartLevelMusic();
+    P_EndLoadStat(LOAD_MUSIC, true);
+
+    P_WriteLoadStats(lumpname, lumpnum, I_GetTimeUS() - start);
 }
 
 //
@@ -1243,7 +1768,26 @@ void P_SetupLevel(int episode, int map)
 //
 void P_Init(void)
 {
+    int i;
+
+    createblockmap = M_CheckParm("-blockmap");
+
     P_InitSwitchList();
     P_InitPicAnims();
+    P_InitMapFixes();
     R_InitSprites(sprnames);
+
+    loadmutex = SDL_CreateMutex();
+    loadcond = SDL_CreateCond();
+
+    //!
+    // @arg <file>
+    //
+    // Write how long each part of loading each level takes to a file, or
+    // to stdout if no file is given, as a line of JSON per level.
+    //
+    if ((i = M_CheckParmWithArgs("-loadstats", 1)))
+        loadstatsfile = fopen(myargv[i + 1], "a");
+    else if (M_CheckParm("-loadstats"))
+        loadstatsfile = stdout;
 }
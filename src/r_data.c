@@ -783,6 +783,7 @@ void R_InitFlats(void)
 void R_InitSpriteLumps(void)
 {
     int i;
+    int *sproffset;
 
     for (i = 0; i < NUMMOBJTYPES; i++)
         mobjinfo[i].canmodify = true;
@@ -796,6 +797,31 @@ void R_InitSpriteLumps(void)
     spriteoffset = Z_Malloc(numspritelumps * sizeof(*spriteoffset), PU_STATIC, 0);
     spritetopoffset = Z_Malloc(numspritelumps * sizeof(*spritetopoffset), PU_STATIC, 0);
 
+    // find which sprite lumps have their offsets overridden by sproffsets[]
+    // in info.c, looking each name up once rather than once per sprite lump
+    sproffset = malloc(numspritelumps * sizeof(*sproffset));
+    for (i = 0; i < numspritelumps; i++)
+        sproffset[i] = -1;
+
+    if (!FREEDOOM && !hacx)
+    {
+        int j = 0;
+
+        while (sproffsets[j].name[0])
+        {
+            if (sproffsets[j].canmodify || BTSX)
+            {
+                int lump = W_CheckNumForName(sproffsets[j].name) - firstspritelump;
+
+                if (lump >= 0 && lump < numspritelumps && sproffset[lump] < 0)
+                    sproffset[lump] = j;
+            }
+            else
+                mobjinfo[sproffsets[j].type].canmodify = false;
+            j++;
+        }
+    }
+
     for (i = 0; i < numspritelumps; i++)
     {
         patch_t *patch = W_CacheLumpNum(firstspritelump + i, PU_CACHE);
@@ -806,28 +832,15 @@ void R_InitSpriteLumps(void)
         spritetopoffset[i] = SHORT(patch->topoffset) << FRACBITS;
 
         // [BH] override sprite offsets in WAD with those in sproffsets[] in info.c
-        if (!FREEDOOM && !hacx)
+        if (sproffset[i] >= 0)
         {
-            int j = 0;
-
-            while (sproffsets[j].name[0])
-            {
-                if (sproffsets[j].canmodify || BTSX)
-                {
-                    if (i == W_CheckNumForName(sproffsets[j].name) - firstspritelump)
-                    {
-                        spriteoffset[i] = SHORT(sproffsets[j].x) << FRACBITS;
-                        spritetopoffset[i] = SHORT(sproffsets[j].y) << FRACBITS;
-                        break;
-                    }
-                }
-                else
-                    mobjinfo[sproffsets[j].type].canmodify = false;
-                j++;
-            }
+            spriteoffset[i] = SHORT(sproffsets[sproffset[i]].x) << FRACBITS;
+            spritetopoffset[i] = SHORT(sproffsets[sproffset[i]].y) << FRACBITS;
         }
     }
 
+    free(sproffset);
+
     if (FREEDOOM)
     {
         states[S_BAR1].tics = 0;
@@ -954,11 +967,11 @@ int R_CheckFlatNumForName(char *name)
 {
     int  i;
 
-    for (i = firstflat; i <= lastflat; i++)
-        if (!strncasecmp(lumpinfo[i].name, name, 8))
-            return (i - firstflat);
+    i = W_CheckNumForNameInRange(firstflat, lastflat, name);
 
-    return -1;
+    if (i == -1)
+        return -1;
+    return (i - firstflat);
 }
 
 //
@@ -1006,12 +1019,27 @@ int R_TextureNumForName(char *name)
 
 //
 // R_PrecacheLevel
-// Preloads all relevant graphics for the level.
+// Preloads all relevant graphics for the level. They are read in the
+// background by W_PrefetchLumps(), so the level can start straight away.
 //
 int flatmemory;
 int texturememory;
 int spritememory;
 
+static int      *precachelumps;
+static int      numprecachelumps;
+static int      maxprecachelumps;
+
+static void R_PrecacheLump(int lump)
+{
+    if (numprecachelumps == maxprecachelumps)
+    {
+        maxprecachelumps = (maxprecachelumps ? maxprecachelumps * 2 : 1024);
+        precachelumps = realloc(precachelumps, maxprecachelumps * sizeof(*precachelumps));
+    }
+    precachelumps[numprecachelumps++] = lump;
+}
+
 void R_PrecacheLevel(void)
 {
     char          *flatpresent;
@@ -1027,6 +1055,8 @@ void R_PrecacheLevel(void)
     thinker_t     *th;
     spriteframe_t *sf;
 
+    numprecachelumps = 0;
+
     // Precache flats.
     flatpresent = Z_Malloc(numflats, PU_STATIC, NULL);
     memset(flatpresent, 0, numflats);
@@ -1045,7 +1075,7 @@ void R_PrecacheLevel(void)
         {
             lump = firstflat + i;
             flatmemory += lumpinfo[lump].size;
-            W_CacheLumpNum(lump, PU_CACHE);
+            R_PrecacheLump(lump);
         }
     }
 
@@ -1082,7 +1112,7 @@ void R_PrecacheLevel(void)
         {
             lump = texture->patches[j].patch;
             texturememory += lumpinfo[lump].size;
-            W_CacheLumpNum(lump, PU_CACHE);
+            R_PrecacheLump(lump);
         }
     }
 
@@ -1111,10 +1141,12 @@ void R_PrecacheLevel(void)
             {
                 lump = firstspritelump + sf->lump[k];
                 spritememory += lumpinfo[lump].size;
-                W_CacheLumpNum(lump, PU_CACHE);
+                R_PrecacheLump(lump);
             }
         }
     }
 
     Z_Free(spritepresent);
+
+    W_PrefetchLumps(precachelumps, numprecachelumps);
 }
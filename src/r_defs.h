@@ -119,7 +119,7 @@ typedef struct
 
     // list of mobjs that are at least partially in the sector
     // thinglist is a subset of touching_thinglist
-    struct msecnode_s   *touching_thinglist;               // phares 3/14/98  
+    int                 touching_thinglist;                // phares 3/14/98
 
     int                 linecount;
     struct line_s       **lines;  // [linecount] size
@@ -526,16 +526,18 @@ typedef struct subsector_s
 // As an mobj moves through the world, these nodes are created and
 // destroyed, with the links changed appropriately.
 //
-// For the links, NULL means top or end of list.
+// The nodes are kept in a pool, and the links are indices into
+// it rather than pointers. Use P_SecNode() to get at a node.
+// For the links, 0 means top or end of list.
 //
 typedef struct msecnode_s
 {
     sector_t            *m_sector;      // a sector containing this object
     struct mobj_s       *m_thing;       // this object
-    struct msecnode_s   *m_tprev;       // prev msecnode_t for this thing
-    struct msecnode_s   *m_tnext;       // next msecnode_t for this thing
-    struct msecnode_s   *m_sprev;       // prev msecnode_t for this sector
-    struct msecnode_s   *m_snext;       // next msecnode_t for this sector
+    int                 m_tprev;        // prev msecnode_t for this thing
+    int                 m_tnext;        // next msecnode_t for this thing
+    int                 m_sprev;        // prev msecnode_t for this sector
+    int                 m_snext;        // next msecnode_t for this sector
 } msecnode_t;
 
 //
@@ -103,6 +103,9 @@ static boolean          mus_paused;
 // Music currently being played
 static musicinfo_t      *mus_playing = NULL;
 
+// Music for the level being loaded
+static int              levelmusic;
+
 // Number of channels to use
 int numChannels = 32;
 
@@ -205,6 +208,10 @@ void S_Init(int sfxVolume, int musicVolume)
     nosfx = (nosound || M_CheckParm("-nosfx") > 0);
     nomusic = (nosound || M_CheckParm("-nomusic") > 0);
 
+    // music needs an audio device, so isn't rendered by -wavout
+    if (M_CheckParmWithArgs("-wavout", 1))
+        nomusic = true;
+
     // Initialize the sound and music subsystems.
     if (!nosound)
     {
@@ -233,6 +240,15 @@ void S_Init(int sfxVolume, int musicVolume)
             // Note that sounds have not been cached (yet).
             for (i = 1; i < NUMSFX; i++)
                 S_sfx[i].lumpnum = -1;
+
+            // precache sounds to avoid slowdown inside game
+            if (sound_module != NULL)
+            {
+                for (i = 1; i < NUMSFX; i++)
+                    S_sfx[i].lumpnum = sound_module->GetSfxLumpNum(&S_sfx[i]);
+
+                sound_module->CacheSounds(S_sfx, NUMSFX);
+            }
         }
 
         if (!nomusic)
@@ -290,19 +306,11 @@ void S_StopSounds(void)
 }
 
 //
-// Per level startup code.
-// Kills playing sounds at start of level,
-//  determines music if any, changes music.
+// S_LevelMusic
+// Returns the music for the given map in the current episode.
 //
-void S_Start(void)
+static int S_LevelMusic(int map)
 {
-    int         mnum;
-
-    S_StopSounds();
-
-    // start new music for the level
-    mus_paused = false;
-
     if (gamemode == commercial)
     {
         if (gamemission == pack_nerve)
@@ -320,10 +328,10 @@ void S_Start(void)
                 mus_ddtblu
             };
 
-            mnum = nmus[gamemap - 1];
+            return nmus[map - 1];
         }
         else
-            mnum = mus_runnin + gamemap - 1;
+            return mus_runnin + map - 1;
     }
     else
     {
@@ -342,12 +350,69 @@ void S_Start(void)
         };
 
         if (gameepisode < 4)
-            mnum = mus_e1m1 + (gameepisode-1) * 9 + gamemap - 1;
+            return mus_e1m1 + (gameepisode - 1) * 9 + map - 1;
         else
-            mnum = spmus[gamemap - 1];
+            return spmus[map - 1];
     }
+}
+
+//
+// S_PrecacheMusic
+// Have the music module prepare a song that's likely to be played soon.
+//
+static void S_PrecacheMusic(int musicnum)
+{
+    musicinfo_t *music = &S_music[musicnum];
+    char        namebuf[9];
+    void        *data;
+
+    if (nomusic || music_module == NULL || music == mus_playing)
+        return;
+
+    if (!music->lumpnum)
+    {
+        int     lumpnum;
+
+        M_snprintf(namebuf, sizeof(namebuf), "d_%s", music->name);
+        if ((lumpnum = W_CheckNumForName(namebuf)) < 0)
+            return;
+        music->lumpnum = lumpnum;
+    }
+
+    data = W_CacheLumpNum(music->lumpnum, PU_STATIC);
+    music_module->PrecacheSong(data, W_LumpLength(music->lumpnum));
+    W_ReleaseLumpNum(music->lumpnum);
+}
+
+//
+// Per level startup code.
+// Kills playing sounds at start of level,
+//  determines music if any, and has it and the
+//  music that's likely to follow prepared while
+//  the level loads.
+//
+void S_Start(void)
+{
+    S_StopSounds();
+
+    levelmusic = S_LevelMusic(gamemap);
+
+    S_PrecacheMusic(levelmusic);
+    S_PrecacheMusic(gamemode == commercial ? mus_dm2int : mus_inter);
+    if (gamemap < (gamemode == commercial && gamemission != pack_nerve ? 32 : 9))
+        S_PrecacheMusic(S_LevelMusic(gamemap + 1));
+}
+
+//
+// S_StartLevelMusic
+// Changes to the music for the level once it's loaded.
+//
+void S_StartLevelMusic(void)
+{
+    // start new music for the level
+    mus_paused = false;
 
-    S_ChangeMusic(mnum, true, false);
+    S_ChangeMusic(levelmusic, true, false);
 }
 
 void S_StopSound(mobj_t *origin)
@@ -73,6 +73,9 @@ typedef struct
     // Returns the lump index of the given sound.
     int (*GetSfxLumpNum)(sfxinfo_t *sfxinfo);
 
+    // Called on startup to precache sound effects
+    void (*CacheSounds)(sfxinfo_t *sounds, int num_sounds);
+
     // Update the sound settings on the given channel.
     void (*UpdateSoundParams)(int channel, int vol, int sep);
 
@@ -110,6 +113,9 @@ typedef struct
     // Un-pause music
     void (*ResumeMusic)(void);
 
+    // Prepare a song that's going to be registered soon
+    void (*PrecacheSong)(void *data, int len);
+
     // Register a song handle from data
     // Returns a handle that can be used to play the song
     void *(*RegisterSong)(void *data, int len);
@@ -130,6 +136,7 @@ typedef struct
 extern int snd_sfxdevice;
 extern int snd_musicdevice;
 extern int snd_samplerate;
+extern int numChannels;
 
 //
 // Initializes sound stuff, including volume
@@ -144,10 +151,13 @@ void S_Shutdown(void);
 //
 // Per level startup code.
 // Kills playing sounds at start of level,
-//  determines music if any, changes music.
+//  determines music if any, and prepares it.
 //
 void S_Start(void);
 
+// Change to the music S_Start() prepared.
+void S_StartLevelMusic(void);
+
 //
 // Start sound for thing at <origin>
 //  using <sound_id> from sounds.h
@@ -39,7 +39,7 @@
 #define PACKAGE_VERSION                 1,6,5,0
 #define PACKAGE_VERSIONSTRING           "1.6.5"
 #define PACKAGE_WADVERSIONSTRING        "DOOM RETRO v1.6.5"
-#define PACKAGE_SAVEGAMEVERSIONSTRING   "DOOM RETRO v1.6.5"
+#define PACKAGE_SAVEGAMEVERSIONSTRING   "DOOM RETRO v1.6.5a"
 
 #define PACKAGE                         "doomretro"
 #define PACKAGE_CONFIG                  "doomretro.cfg"
@@ -40,6 +40,7 @@
 
 #include "doomtype.h"
 #include "m_argv.h"
+#include "SDL.h"
 #include "w_file.h"
 
 extern wad_file_class_t stdc_wad_file;
@@ -52,6 +53,10 @@ extern wad_file_class_t win32_wad_file;
 extern wad_file_class_t posix_wad_file;
 #endif 
 
+// Lumps may be read on another thread while the main thread is reading
+// from the same file, so only one read is done at a time.
+static SDL_mutex        *readmutex;
+
 static wad_file_class_t *wad_file_classes[] =
 {
 #ifdef WIN32
@@ -68,6 +73,9 @@ wad_file_t *W_OpenFile(char *path)
     wad_file_t  *result;
     int         i;
 
+    if (!readmutex)
+        readmutex = SDL_CreateMutex();
+
     //!
     // Use the OS's virtual memory subsystem to map WAD files
     // directly into memory.
@@ -96,5 +104,11 @@ void W_CloseFile(wad_file_t *wad)
 
 size_t W_Read(wad_file_t *wad, unsigned int offset, void *buffer, size_t buffer_len)
 {
-    return wad->file_class->Read(wad, offset, buffer, buffer_len);
+    size_t      result;
+
+    SDL_LockMutex(readmutex);
+    result = wad->file_class->Read(wad, offset, buffer, buffer_len);
+    SDL_UnlockMutex(readmutex);
+
+    return result;
 }
@@ -56,6 +56,10 @@ typedef struct
 {
     lumpinfo_t          *lumps;
     int                 numlumps;
+
+    // optional hash table of the names in the list, chained through next
+    int                 *hash;
+    int                 *next;
 } searchlist_t;
 
 typedef struct
@@ -63,8 +67,12 @@ typedef struct
     char                sprname[4];
     char                frame;
     lumpinfo_t          *angle_lumps[8];
+    int                 next;           // next frame in the same hash chain
 } sprite_frame_t;
 
+#define SPRITEFRAMEHASHSIZE     1024
+#define SPROFFSETHASHSIZE       1024
+
 static searchlist_t     iwad;
 static searchlist_t     iwad_sprites;
 static searchlist_t     pwad;
@@ -77,17 +85,27 @@ static searchlist_t     pwad_flats;
 static sprite_frame_t   *sprite_frames;
 static int              num_sprite_frames;
 static int              sprite_frames_alloced;
+static int              sprite_frames_hash[SPRITEFRAMEHASHSIZE];
 
 wad_file_t              *tempwad;
 
 // Search in a list to find a lump with a particular name
-// Linear search (slow!)
+// Linear search (slow!) unless the list has been hashed
 //
 // Returns -1 if not found
 static int FindInList(searchlist_t *list, char *name)
 {
     int i;
 
+    if (list->hash)
+    {
+        for (i = list->hash[W_LumpNameHash(name) % list->numlumps]; i >= 0; i = list->next[i])
+            if (!strncasecmp(list->lumps[i].name, name, 8))
+                return i;
+
+        return -1;
+    }
+
     for (i = 0; i < list->numlumps; ++i)
         if (!strncasecmp(list->lumps[i].name, name, 8))
             return i;
@@ -95,6 +113,38 @@ static int FindInList(searchlist_t *list, char *name)
     return -1;
 }
 
+// Hash the names in a list, so FindInList doesn't have to search it
+static void HashList(searchlist_t *list)
+{
+    int i;
+
+    if (list->numlumps <= 0)
+        return;
+
+    list->hash = malloc(list->numlumps * sizeof(int));
+    list->next = malloc(list->numlumps * sizeof(int));
+
+    for (i = 0; i < list->numlumps; ++i)
+        list->hash[i] = -1;
+
+    // add them backwards, so the first lump with a name is found first
+    for (i = list->numlumps - 1; i >= 0; --i)
+    {
+        int     hash = W_LumpNameHash(list->lumps[i].name) % list->numlumps;
+
+        list->next[i] = list->hash[hash];
+        list->hash[hash] = i;
+    }
+}
+
+static void FreeListHash(searchlist_t *list)
+{
+    free(list->hash);
+    free(list->next);
+    list->hash = NULL;
+    list->next = NULL;
+}
+
 static boolean SetupList(searchlist_t *list, searchlist_t *src_list,
                          char *startname, char *endname, char *startname2, char *endname2)
 {
@@ -142,6 +192,8 @@ static void SetupLists(void)
 // Initialize the replace list
 static void InitSpriteList(void)
 {
+    int                 i;
+
     if (sprite_frames == NULL)
     {
         sprite_frames_alloced = 128;
@@ -149,16 +201,31 @@ static void InitSpriteList(void)
     }
 
     num_sprite_frames = 0;
+
+    for (i = 0; i < SPRITEFRAMEHASHSIZE; ++i)
+        sprite_frames_hash[i] = -1;
+}
+
+static unsigned int SpriteFrameHash(char *name, char frame)
+{
+    char        key[6];
+
+    strncpy(key, name, 4);
+    key[4] = frame;
+    key[5] = '\0';
+
+    return (W_LumpNameHash(key) % SPRITEFRAMEHASHSIZE);
 }
 
 // Find a sprite frame
 static sprite_frame_t *FindSpriteFrame(char *name, char frame)
 {
     sprite_frame_t      *result;
+    unsigned int        hash = SpriteFrameHash(name, frame);
     int                 i;
 
     // Search the list and try to find the frame
-    for (i = 0; i < num_sprite_frames; ++i)
+    for (i = sprite_frames_hash[hash]; i >= 0; i = sprite_frames[i].next)
     {
         sprite_frame_t *cur = &sprite_frames[i];
 
@@ -188,6 +255,9 @@ static sprite_frame_t *FindSpriteFrame(char *name, char frame)
     for (i = 0; i < 8; ++i)
         result->angle_lumps[i] = NULL;
 
+    result->next = sprite_frames_hash[hash];
+    sprite_frames_hash[hash] = num_sprite_frames;
+
     ++num_sprite_frames;
 
     return result;
@@ -280,12 +350,66 @@ static void AddSpriteLump(lumpinfo_t *lump)
         sprite->angle_lumps[angle_num - 1] = lump;
 }
 
+// sproffsets[] in info.c hashed by name, and by sprite name
+static int              sproffsets_byname[SPROFFSETHASHSIZE];
+static int              sproffsets_bysprite[SPROFFSETHASHSIZE];
+static int              *sproffsets_nextname;
+static int              *sproffsets_nextsprite;
+
+static unsigned int SpriteNameHash(char *name)
+{
+    char        sprname[5];
+
+    M_StringCopy(sprname, name, 5);
+
+    return (W_LumpNameHash(sprname) % SPROFFSETHASHSIZE);
+}
+
+static void HashSprOffsets(void)
+{
+    int                 count = 0;
+    int                 i;
+
+    while (sproffsets[count].name[0])
+        count++;
+
+    sproffsets_nextname = malloc(count * sizeof(int));
+    sproffsets_nextsprite = malloc(count * sizeof(int));
+
+    for (i = 0; i < SPROFFSETHASHSIZE; ++i)
+        sproffsets_byname[i] = sproffsets_bysprite[i] = -1;
+
+    // add them backwards, so each chain is in the same order as sproffsets[]
+    for (i = count - 1; i >= 0; --i)
+    {
+        unsigned int    hash = W_LumpNameHash(sproffsets[i].name) % SPROFFSETHASHSIZE;
+
+        sproffsets_nextname[i] = sproffsets_byname[hash];
+        sproffsets_byname[hash] = i;
+
+        hash = SpriteNameHash(sproffsets[i].name);
+        sproffsets_nextsprite[i] = sproffsets_bysprite[hash];
+        sproffsets_bysprite[hash] = i;
+    }
+}
+
+// Stop any of the offsets in sproffsets[] for a sprite being used
+static void DisableSprOffsets(char *name)
+{
+    int                 k;
+
+    for (k = sproffsets_bysprite[SpriteNameHash(name)]; k >= 0; k = sproffsets_nextsprite[k])
+        if (!strncasecmp(sproffsets[k].name, name, 4))
+            sproffsets[k].canmodify = false;
+}
+
 // Generate the list.  Run at the start, before merging
 static void GenerateSpriteList(void)
 {
     int                 i;
 
     InitSpriteList();
+    HashSprOffsets();
 
     // Add all sprites from the IWAD
     for (i = 0; i < iwad_sprites.numlumps; ++i)
@@ -310,40 +434,25 @@ static void GenerateSpriteList(void)
 
         if (i < iwad_sprites.numlumps)
         {
-            int j = 0;
+            int j;
 
-            while (sproffsets[j].name[0])
-            {
-                if (!strcasecmp(sproffsets[j].name, lump->name) && sproffsets[j].canmodify)
+            for (j = sproffsets_byname[W_LumpNameHash(lump->name) % SPROFFSETHASHSIZE]; j >= 0;
+                j = sproffsets_nextname[j])
+                if (!strncasecmp(sproffsets[j].name, lump->name, 8) && sproffsets[j].canmodify)
                 {
-                    int         k = 0;
-                    char        name1[9];
-
                     sproffsets[j].canmodify = false;
 
-                    M_StringCopy(name1, sproffsets[j].name, 9);
-                    name1[4] = '\0';
-
-                    while (sproffsets[k].name[0])
-                    {
-                        char    name2[9];
-
-                        M_StringCopy(name2, sproffsets[k].name, 9);
-                        name2[4] = '\0';
-
-                        if (!strcasecmp(name1, name2) ||
-                            (!strcasecmp(name1, "BAR1") && !strcasecmp(name2, "BEXP")))
-                            sproffsets[k].canmodify = false;
-
-                        k++;
-                    }
+                    DisableSprOffsets(sproffsets[j].name);
+                    if (!strncasecmp(sproffsets[j].name, "BAR1", 4))
+                        DisableSprOffsets("BEXP");
                 }
-                j++;
-            }
         }
 
         AddSpriteLump(lump);
     }
+
+    free(sproffsets_nextname);
+    free(sproffsets_nextsprite);
 }
 
 // Perform the merge.
@@ -533,7 +642,9 @@ boolean W_MergeFile(char *filename)
     GenerateSpriteList();
 
     // Perform the merge
+    HashList(&pwad_flats);
     DoMerge();
+    FreeListHash(&pwad_flats);
 
     return true;
 }
@@ -43,6 +43,7 @@
 #include "i_swap.h"
 #include "i_system.h"
 #include "m_misc.h"
+#include "SDL.h"
 #include "w_wad.h"
 #include "z_zone.h"
 
@@ -78,9 +79,31 @@ typedef struct
 lumpinfo_t      *lumpinfo;
 unsigned int    numlumps = 0;
 
-// Hash table for fast lookups
+// how many bytes have been read from lumps
+size_t          lumpbytesread;
 
-static lumpinfo_t **lumphash;
+// Index of the lump directory for fast lookups. There is an entry for
+// each name in each namespace, and one for each name in ns_all, so every
+// lump is in two entries. Names are packed into 64-bit keys so they can be
+// compared in one go.
+typedef struct
+{
+    uint64_t            key;
+    lumpnamespace_t     ns;
+    int                 first;  // first lump with this name in this namespace
+    int                 last;   // last lump with this name in this namespace
+    int                 count;  // how many lumps have this name in this namespace
+} lumpindex_t;
+
+static lumpindex_t      *lumpindex;
+static unsigned int     lumpindexmask;
+
+// next lump with the same name in any namespace, or in the same namespace
+static int              *lumpnext;
+static int              *lumpnextns;
+
+// which run of lumps between markers each lump is in
+static int              *lumpblock;
 
 void ExtractFileBase(char *path, char *dest)
 {
@@ -137,11 +160,6 @@ static void ExtendLumpInfo(int newnumlumps)
 
         if (newlumpinfo[i].cache != NULL)
             Z_ChangeUser(newlumpinfo[i].cache, &newlumpinfo[i].cache);
-
-        // We shouldn't be generating a hash table until after all WADs have
-        // been loaded, but just in case...
-        if (lumpinfo[i].next != NULL)
-            newlumpinfo[i].next = &newlumpinfo[lumpinfo[i].next - lumpinfo];
     }
 
     // All done.
@@ -244,11 +262,7 @@ wad_file_t *W_AddFile(char *filename)
 
     Z_Free(fileinfo);
 
-    if (lumphash != NULL)
-    {
-        Z_Free(lumphash);
-        lumphash = NULL;
-    }
+    W_FreeHashTable();
 
     return wad_file;
 }
@@ -384,38 +398,48 @@ int W_NumLumps(void)
 }
 
 //
-// W_CheckNumForName
-// Returns -1 if name not found.
+// W_LumpNameKey
+// Pack a lump name into a 64-bit key, in upper case and padded with zeros,
+// so that names can be compared in one go.
 //
-int W_CheckNumForName(char *name)
+static uint64_t W_LumpNameKey(const char *name)
 {
-    lumpinfo_t  *lump_p;
+    uint64_t    key = 0;
     int         i;
 
-    // Do we have a hash table yet?
-    if (lumphash != NULL)
-    {
-        int     hash;
+    for (i = 0; i < 8 && name[i] != '\0'; ++i)
+        key |= (uint64_t)(byte)toupper(name[i]) << (i * 8);
 
-        // We do! Excellent.
-        hash = W_LumpNameHash(name) % numlumps;
+    return key;
+}
 
-        for (lump_p = lumphash[hash]; lump_p != NULL; lump_p = lump_p->next)
-            if (!strncasecmp(lump_p->name, name, 8))
-                return lump_p - lumpinfo;
-    }
-    else
-    {
-        // We don't have a hash table generate yet. Linear search :-(
-        //
-        // scan backwards so patch lump files take precedence
-        for (i = numlumps - 1; i >= 0; --i)
-            if (!strncasecmp(lumpinfo[i].name, name, 8))
-                return i;
-    }
+static lumpindex_t *W_FindIndex(uint64_t key, lumpnamespace_t ns)
+{
+    unsigned int        i;
 
-    // TFB. Not found.
-    return -1;
+    if (!lumpindex)
+        W_GenerateHashTable();
+    if (!lumpindex)
+        return NULL;
+
+    for (i = (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32) & lumpindexmask;
+        lumpindex[i].count; i = (i + 1) & lumpindexmask)
+        if (lumpindex[i].key == key && lumpindex[i].ns == ns)
+            return &lumpindex[i];
+
+    return NULL;
+}
+
+//
+// W_CheckNumForName
+// Returns -1 if name not found.
+//
+int W_CheckNumForName(char *name)
+{
+    lumpindex_t *index = W_FindIndex(W_LumpNameKey(name), ns_all);
+
+    // the last one found, so patch lump files take precedence
+    return (index ? index->last : -1);
 }
 
 //
@@ -424,35 +448,64 @@ int W_CheckNumForName(char *name)
 //
 int W_CheckMultipleLumps(char *name)
 {
-    int         i;
-    int         count = 0;
+    lumpindex_t *index;
 
     if (FREEDOOM || hacx)
         return 3;
 
-    for (i = numlumps - 1; i >= 0; --i)
-        if (!strncasecmp(lumpinfo[i].name, name, 8))
-            ++count;
+    index = W_FindIndex(W_LumpNameKey(name), ns_all);
 
-    return count;
+    return (index ? index->count : 0);
 }
 
 //
-// W_RangeCheckNumForName
-// Linear Search that checks for a lump number ONLY
-// inside a range, not all lumps.
+// W_CheckNumForNameInRange
+// Returns the first lump with the given name inside a range of lumps,
+// or -1 if there isn't one. If the range lies between one pair of markers,
+// only the lumps with that name in their namespace need be checked.
 //
-int W_RangeCheckNumForName(int min, int max, char *name)
+int W_CheckNumForNameInRange(int min, int max, char *name)
 {
-    int         i;
+    uint64_t            key = W_LumpNameKey(name);
+    lumpnamespace_t     ns = ns_all;
+    int                 *next = lumpnext;
+    lumpindex_t         *index;
+    int                 i;
 
-    for (i = min; i <= max; i++)
-        if (!strncasecmp(lumpinfo[i].name, name, 8))
+    if (min < 0 || max >= (int)numlumps || min > max)
+        return -1;
+
+    if (!lumpindex)
+        W_GenerateHashTable();
+
+    if (lumpblock[min] == lumpblock[max] && lumpinfo[min].ns != ns_global)
+    {
+        ns = lumpinfo[min].ns;
+        next = lumpnextns;
+    }
+
+    if (!(index = W_FindIndex(key, ns)))
+        return -1;
+
+    for (i = index->first; i >= 0 && i <= max; i = next[i])
+        if (i >= min)
             return i;
 
-    I_Error("W_RangeCheckNumForName: %s not found!", name);
+    return -1;
+}
 
-    return 0;
+//
+// W_RangeCheckNumForName
+// Checks for a lump number ONLY inside a range, not all lumps.
+//
+int W_RangeCheckNumForName(int min, int max, char *name)
+{
+    int         i = W_CheckNumForNameInRange(min, max, name);
+
+    if (i < 0)
+        I_Error("W_RangeCheckNumForName: %s not found!", name);
+
+    return i;
 }
 
 //
@@ -474,30 +527,24 @@ int W_GetNumForName(char *name)
 // Go forwards rather than backwards so we get lump from IWAD and not PWAD
 int W_GetNumForName2(char *name)
 {
-    unsigned int i;
+    lumpindex_t *index = W_FindIndex(W_LumpNameKey(name), ns_all);
 
-    for (i = 0; i < numlumps; i++)
-        if (!strncasecmp(lumpinfo[i].name, name, 8))
-            break;
-
-    if (i == numlumps)
+    if (!index)
         I_Error("W_GetNumForName: %s not found!", name);
 
-    return i;
+    return index->first;
 }
 
 int W_GetNumForNameX(char *name, unsigned int count)
 {
-    unsigned int i, j = 0;
-
-    for (i = 0; i < numlumps; i++)
-        if (!strncasecmp(lumpinfo[i].name, name, 8))
-            if (++j == count)
-                break;
+    lumpindex_t *index = W_FindIndex(W_LumpNameKey(name), ns_all);
+    int         i;
 
-    if (i == numlumps && j != count)
+    if (!index || !count || count > (unsigned int)index->count)
         I_Error("W_GetNumForNameX: %s not found!", name);
 
+    for (i = index->first; --count; i = lumpnext[i]);
+
     return i;
 }
 
@@ -529,11 +576,276 @@ void W_ReadLump(unsigned int lump, void *dest)
     l = lumpinfo + lump;
 
     c = W_Read(l->wad_file, l->position, dest, l->size);
+    lumpbytesread += c;
 
     if (c < l->size)
         I_Error("W_ReadLump: only read %i of %i on lump %i", c, l->size, lump);
 }
 
+//
+// Lump prefetching
+// The lumps given to W_PrefetchLumps() are read into memory one after the
+// other on another thread, and moved into the zone as PU_CACHE on the main
+// thread by W_UpdatePrefetch() once they have arrived. If one is needed
+// before then, W_CacheLumpNum() waits for it if it's being read, or reads
+// it itself if it hasn't been started yet.
+//
+typedef enum
+{
+    PREFETCH_WAITING,
+    PREFETCH_READING,
+    PREFETCH_READ,
+    PREFETCH_DONE
+} prefetchstate_t;
+
+typedef struct
+{
+    int                 lump;
+    wad_file_t          *wad_file;
+    unsigned int        position;
+    int                 size;
+    byte                *data;
+    prefetchstate_t     state;
+} prefetch_t;
+
+static prefetch_t       *prefetches;
+static int              numprefetches;
+static int              *prefetchindex;         // prefetch for each lump + 1, or 0
+static int              prefetchnext;
+static int              prefetchinstalled;
+static boolean          prefetchcancel;
+
+static SDL_mutex        *prefetchmutex;
+static SDL_cond         *prefetchcond;
+static SDL_Thread       *prefetchthread;
+
+static int W_PrefetchThread(void *arg)
+{
+    SDL_LockMutex(prefetchmutex);
+
+    while (!prefetchcancel && prefetchnext < numprefetches)
+    {
+        prefetch_t      *prefetch = &prefetches[prefetchnext++];
+        byte            *data;
+
+        // the main thread may have needed it already
+        if (prefetch->state != PREFETCH_WAITING)
+            continue;
+
+        prefetch->state = PREFETCH_READING;
+        SDL_UnlockMutex(prefetchmutex);
+
+        // only malloc() can be used here, as the zone isn't thread-safe
+        if ((data = malloc(prefetch->size))
+            && W_Read(prefetch->wad_file, prefetch->position, data, prefetch->size) < (size_t)prefetch->size)
+        {
+            // leave it to the main thread to read it again and report the error
+            free(data);
+            data = NULL;
+        }
+
+        SDL_LockMutex(prefetchmutex);
+        prefetch->data = data;
+        prefetch->state = (data ? PREFETCH_READ : PREFETCH_DONE);
+        SDL_CondBroadcast(prefetchcond);
+    }
+
+    SDL_UnlockMutex(prefetchmutex);
+
+    return 0;
+}
+
+// Move a prefetched lump into the zone, counting it as read only now, as
+// lumpbytesread is only changed on the main thread
+static void W_InstallPrefetch(prefetch_t *prefetch, int tag)
+{
+    lumpinfo_t  *lump = &lumpinfo[prefetch->lump];
+
+    lumpbytesread += prefetch->size;
+
+    if (!lump->cache)
+    {
+        lump->cache = Z_Malloc(prefetch->size, tag, &lump->cache);
+        memcpy(lump->cache, prefetch->data, prefetch->size);
+    }
+
+    free(prefetch->data);
+    prefetch->data = NULL;
+    prefetch->state = PREFETCH_DONE;
+}
+
+// Use a lump that was to be prefetched, returning false if it hasn't been
+// read and so must be read by the caller instead
+static boolean W_TakePrefetch(int lumpnum, int tag)
+{
+    prefetch_t  *prefetch = &prefetches[prefetchindex[lumpnum] - 1];
+    boolean     result = false;
+
+    SDL_LockMutex(prefetchmutex);
+
+    // it will be ready soon, so wait for it
+    while (prefetch->state == PREFETCH_READING)
+        SDL_CondWait(prefetchcond, prefetchmutex);
+
+    if (prefetch->state == PREFETCH_READ)
+    {
+        W_InstallPrefetch(prefetch, tag);
+        result = true;
+    }
+    else
+        prefetch->state = PREFETCH_DONE;
+
+    SDL_UnlockMutex(prefetchmutex);
+
+    return result;
+}
+
+static void W_FreePrefetches(void)
+{
+    free(prefetches);
+    free(prefetchindex);
+    prefetches = NULL;
+    prefetchindex = NULL;
+    numprefetches = 0;
+}
+
+//
+// W_FinishPrefetch
+// Stop prefetching any lumps that haven't been read yet, and move those
+// that have into the zone.
+//
+void W_FinishPrefetch(void)
+{
+    int i;
+
+    if (!prefetches)
+        return;
+
+    SDL_LockMutex(prefetchmutex);
+    prefetchcancel = true;
+    SDL_UnlockMutex(prefetchmutex);
+
+    SDL_WaitThread(prefetchthread, NULL);
+    prefetchthread = NULL;
+
+    for (i = 0; i < numprefetches; i++)
+        if (prefetches[i].state == PREFETCH_READ)
+            W_InstallPrefetch(&prefetches[i], PU_CACHE);
+
+    W_FreePrefetches();
+}
+
+//
+// W_UpdatePrefetch
+// Move the lumps that have been prefetched since the last call into the
+// zone. Called once a frame.
+//
+void W_UpdatePrefetch(void)
+{
+    boolean     finished;
+
+    if (!prefetches)
+        return;
+
+    SDL_LockMutex(prefetchmutex);
+
+    while (prefetchinstalled < numprefetches && prefetches[prefetchinstalled].state >= PREFETCH_READ)
+    {
+        if (prefetches[prefetchinstalled].state == PREFETCH_READ)
+            W_InstallPrefetch(&prefetches[prefetchinstalled], PU_CACHE);
+        prefetchinstalled++;
+    }
+
+    finished = (prefetchinstalled == numprefetches);
+
+    SDL_UnlockMutex(prefetchmutex);
+
+    if (finished)
+        W_FinishPrefetch();
+}
+
+// Sort prefetches by file and then position, so each file is read in order
+static int W_ComparePrefetches(const void *a, const void *b)
+{
+    const prefetch_t    *prefetch1 = (const prefetch_t *)a;
+    const prefetch_t    *prefetch2 = (const prefetch_t *)b;
+
+    if (prefetch1->wad_file != prefetch2->wad_file)
+        return (prefetch1->wad_file < prefetch2->wad_file ? -1 : 1);
+
+    return (prefetch1->position < prefetch2->position ? -1 :
+        (prefetch1->position > prefetch2->position ? 1 : 0));
+}
+
+//
+// W_PrefetchLumps
+// Start reading the given lumps into the zone as PU_CACHE in the background.
+// Without threads, they are read before returning instead.
+//
+void W_PrefetchLumps(int *lumps, int count)
+{
+    int i;
+
+    W_FinishPrefetch();
+
+#ifdef SDL20
+    if (!prefetchmutex)
+    {
+        prefetchmutex = SDL_CreateMutex();
+        prefetchcond = SDL_CreateCond();
+    }
+
+    if (prefetchmutex && prefetchcond)
+    {
+        prefetches = malloc(count * sizeof(*prefetches));
+        prefetchindex = calloc(numlumps, sizeof(*prefetchindex));
+
+        // skip those already in memory, and any given more than once
+        for (i = 0; i < count; i++)
+        {
+            int         lumpnum = lumps[i];
+            lumpinfo_t  *lump = &lumpinfo[lumpnum];
+
+            if (!lump->wad_file->mapped && !lump->cache && lump->size > 0
+                && !prefetchindex[lumpnum])
+            {
+                prefetch_t      *prefetch = &prefetches[numprefetches++];
+
+                prefetch->lump = lumpnum;
+                prefetch->wad_file = lump->wad_file;
+                prefetch->position = lump->position;
+                prefetch->size = lump->size;
+                prefetch->data = NULL;
+                prefetch->state = PREFETCH_WAITING;
+                prefetchindex[lumpnum] = numprefetches;
+            }
+        }
+
+        if (!numprefetches)
+        {
+            W_FreePrefetches();
+            return;
+        }
+
+        qsort(prefetches, numprefetches, sizeof(*prefetches), W_ComparePrefetches);
+        for (i = 0; i < numprefetches; i++)
+            prefetchindex[prefetches[i].lump] = i + 1;
+
+        prefetchnext = 0;
+        prefetchinstalled = 0;
+        prefetchcancel = false;
+
+        if ((prefetchthread = SDL_CreateThread(W_PrefetchThread, "prefetch", NULL)))
+            return;
+
+        W_FreePrefetches();
+    }
+#endif
+
+    for (i = 0; i < count; i++)
+        W_CacheLumpNum(lumps[i], PU_CACHE);
+}
+
 //
 // W_CacheLumpNum
 //
@@ -573,9 +885,12 @@ void *W_CacheLumpNum(int lumpnum, int tag)
     }
     else
     {
-        // Not yet loaded, so load it now
-        lump->cache = Z_Malloc(W_LumpLength(lumpnum), tag, &lump->cache);
-        W_ReadLump(lumpnum, lump->cache);
+        // Not yet loaded, so use it if it has been prefetched, or load it now
+        if (!prefetchindex || !prefetchindex[lumpnum] || !W_TakePrefetch(lumpnum, tag))
+        {
+            lump->cache = Z_Malloc(W_LumpLength(lumpnum), tag, &lump->cache);
+            W_ReadLump(lumpnum, lump->cache);
+        }
         result = (byte *)lump->cache;
     }
 
@@ -617,33 +932,121 @@ void W_ReleaseLumpName(char *name)
     W_ReleaseLumpNum(W_GetNumForName(name));
 }
 
-// Generate a hash table for fast lookups
+//
+// W_FreeHashTable
+// Free the lump index. It is generated again when it is next needed.
+//
+void W_FreeHashTable(void)
+{
+    if (lumpindex)
+    {
+        Z_Free(lumpindex);
+        Z_Free(lumpnext);
+        Z_Free(lumpnextns);
+        Z_Free(lumpblock);
+        lumpindex = NULL;
+        lumpnext = NULL;
+        lumpnextns = NULL;
+        lumpblock = NULL;
+    }
+}
+
+static void W_AddToIndex(int lump, uint64_t key, lumpnamespace_t ns, int *next)
+{
+    unsigned int        i;
+
+    for (i = (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32) & lumpindexmask;
+        lumpindex[i].count; i = (i + 1) & lumpindexmask)
+        if (lumpindex[i].key == key && lumpindex[i].ns == ns)
+        {
+            next[lumpindex[i].last] = lump;
+            lumpindex[i].last = lump;
+            lumpindex[i].count++;
+            return;
+        }
+
+    lumpindex[i].key = key;
+    lumpindex[i].ns = ns;
+    lumpindex[i].first = lumpindex[i].last = lump;
+    lumpindex[i].count = 1;
+}
+
+// The markers that start and end each namespace. The markers themselves
+// are in the global namespace.
+static struct
+{
+    char                *name;
+    lumpnamespace_t     ns;     // the namespace started, or ns_global if one is ended
+} markers[] =
+{
+    { "F_START",  ns_flats   },
+    { "FF_START", ns_flats   },
+    { "F_END",    ns_global  },
+    { "FF_END",   ns_global  },
+    { "S_START",  ns_sprites },
+    { "SS_START", ns_sprites },
+    { "S_END",    ns_global  },
+    { "SS_END",   ns_global  }
+};
+
+#define NUMMARKERS      (sizeof(markers) / sizeof(*markers))
+
+//
+// W_GenerateHashTable
+// Generate the lump index for fast lookups
+//
 void W_GenerateHashTable(void)
 {
     unsigned int        i;
+    unsigned int        size = 1;
+    lumpnamespace_t     ns = ns_global;
+    int                 block = 0;
+    uint64_t            markerkeys[NUMMARKERS];
+
+    // Free the old index, if there is one
+    W_FreeHashTable();
+
+    if (!numlumps)
+        return;
+
+    // every lump goes in two entries, and keep the table no more than half full
+    while (size < numlumps * 4)
+        size <<= 1;
+    lumpindexmask = size - 1;
+
+    lumpindex = (lumpindex_t *)Z_Malloc(size * sizeof(lumpindex_t), PU_STATIC, NULL);
+    memset(lumpindex, 0, size * sizeof(lumpindex_t));
+    lumpnext = (int *)Z_Malloc(numlumps * sizeof(int), PU_STATIC, NULL);
+    lumpnextns = (int *)Z_Malloc(numlumps * sizeof(int), PU_STATIC, NULL);
+    lumpblock = (int *)Z_Malloc(numlumps * sizeof(int), PU_STATIC, NULL);
 
-    // Free the old hash table, if there is one
-    if (lumphash != NULL)
-        Z_Free(lumphash);
+    for (i = 0; i < NUMMARKERS; ++i)
+        markerkeys[i] = W_LumpNameKey(markers[i].name);
 
-    // Generate hash table
-    if (numlumps > 0)
+    for (i = 0; i < numlumps; ++i)
     {
-        lumphash = (lumpinfo_t **)Z_Malloc(sizeof(lumpinfo_t *) * numlumps, PU_STATIC, NULL);
-        memset(lumphash, 0, sizeof(lumpinfo_t *) * numlumps);
+        uint64_t        key = W_LumpNameKey(lumpinfo[i].name);
+        unsigned int    j;
 
-        for (i = 0; i < numlumps; ++i)
-        {
-            unsigned int        hash;
+        for (j = 0; j < NUMMARKERS; ++j)
+            if (key == markerkeys[j])
+            {
+                ns = ns_global;
+                block++;
+                break;
+            }
 
-            hash = W_LumpNameHash(lumpinfo[i].name) % numlumps;
+        lumpinfo[i].ns = ns;
+        lumpblock[i] = block;
+        lumpnext[i] = lumpnextns[i] = -1;
 
-            // Hook into the hash table
+        W_AddToIndex(i, key, ns_all, lumpnext);
+        W_AddToIndex(i, key, ns, lumpnextns);
 
-            lumpinfo[i].next = lumphash[hash];
-            lumphash[hash] = &lumpinfo[i];
+        if (j < NUMMARKERS)
+        {
+            ns = markers[j].ns;
+            block++;
         }
     }
-
-    // All done!
 }
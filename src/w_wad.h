@@ -56,6 +56,15 @@
 #define IWAD 1
 #define PWAD 2
 
+// The namespaces a lump can be in, going by the markers around it.
+typedef enum
+{
+    ns_global,
+    ns_flats,                   // between F_START/FF_START and F_END/FF_END
+    ns_sprites,                 // between S_START/SS_START and S_END/SS_END
+    ns_all                      // for looking up a lump in any namespace
+} lumpnamespace_t;
+
 typedef struct lumpinfo_s lumpinfo_t;
 
 struct lumpinfo_s
@@ -66,17 +75,19 @@ struct lumpinfo_s
     int         size;
     void        *cache;
 
-    // Used for hash table lookups
-    lumpinfo_t  *next;
+    // Set when the lump index is generated
+    lumpnamespace_t     ns;
 };
 
 extern lumpinfo_t *lumpinfo;
 extern unsigned int numlumps;
+extern size_t lumpbytesread;
 
 wad_file_t *W_AddFile(char *filename);
 int W_WadType(char *filename);
 
 int W_CheckNumForName(char *name);
+int W_CheckNumForNameInRange(int min, int max, char *name);
 int W_RangeCheckNumForName(int min, int max, char *name);
 int W_GetNumForName(char *name);
 int W_GetNumForName2(char *name);
@@ -91,9 +102,14 @@ void *W_CacheLumpNum(int lump, int tag);
 void *W_CacheLumpName(char *name, int tag);
 
 void W_GenerateHashTable(void);
+void W_FreeHashTable(void);
 
 extern unsigned int W_LumpNameHash(const char *s);
 
+void W_PrefetchLumps(int *lumps, int count);
+void W_UpdatePrefetch(void);
+void W_FinishPrefetch(void);
+
 void W_ReleaseLumpNum(int lump);
 void W_ReleaseLumpName(char *name);
 
@@ -58,6 +58,14 @@ static const size_t     HEADER_SIZE = (sizeof(memblock_t) + CHUNK_SIZE - 1) & ~(
 
 static memblock_t       *blockbytag[PU_MAX];
 
+// how many blocks have been allocated, and how big they were altogether
+int                     zoneallocations;
+size_t                  zoneallocated;
+
+// how much is allocated right now, and the most that has been at once
+size_t                  zoneinuse;
+size_t                  zonepeak;
+
 //
 // Z_Malloc
 // You can pass a NULL user if the tag is < PU_PURGELEVEL.
@@ -100,6 +108,11 @@ void *Z_Malloc(size_t size, int32_t tag, void **user)
     }
 
     block->size = size;
+    zoneallocations++;
+    zoneallocated += size;
+    zoneinuse += size;
+    if (zoneinuse > zonepeak)
+        zonepeak = zoneinuse;
 
     block->tag = tag;                                   // tag
     block->user = user;                                 // user
@@ -127,6 +140,8 @@ void Z_Free(void *p)
     block->prev->next = block->next;
     block->next->prev = block->prev;
 
+    zoneinuse -= block->size;
+
     free(block);
 }
 
@@ -71,4 +71,9 @@ void Z_FreeTags(int32_t lowtag, int32_t hightag);
 void Z_ChangeTag(void *ptr, int32_t tag);
 void Z_ChangeUser(void *ptr, void **user);
 
+extern int      zoneallocations;
+extern size_t   zoneallocated;
+extern size_t   zoneinuse;
+extern size_t   zonepeak;
+
 #endif